@@ -11,27 +11,49 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "assert.h"
 #include "compress40.h"
+#include "compression.h"
+#include "parallel.h"
+#include "stats.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
 int main(int argc, char *argv[])
 {
         int i;
+        bool streaming = false;
+        bool stats = false, statsJson = false;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                } else if (strcmp(argv[i], "-j") == 0) {
+                        int threads = (i + 1 < argc) ? atoi(argv[++i]) : 0;
+                        if (threads < 1) {
+                                fprintf(stderr, "%s: -j needs a thread count "
+                                        "of at least 1\n", argv[0]);
+                                exit(1);
+                        }
+                        Parallel_set_threads(threads);
+                } else if (strcmp(argv[i], "-s") == 0) {
+                        streaming = true;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        stats = true;
+                } else if (strcmp(argv[i], "--stats=json") == 0) {
+                        stats = statsJson = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
+                        fprintf(stderr, "Usage: %s [-j N | -s] "
+                                "[--stats[=json]] -d [filename]\n"
+                                "       %s [-j N | -s] [--stats[=json]] "
+                                "-c [filename]\n",
                                 argv[0], argv[0]);
                         exit(1);
                 } else {
@@ -39,6 +61,22 @@ int main(int argc, char *argv[])
                 }
         }
         assert(argc - i <= 1);    /* at most one file on command line */
+
+        /* bounded memory mode: read and write the image a row at a time */
+        if (streaming && compress_or_decompress == compress40) {
+                compress_or_decompress = compress40_stream;
+        } else if (streaming) {
+                compress_or_decompress = decompress40_stream;
+        } else if (compress_or_decompress == decompress40 && i < argc) {
+                /* a named file is mapped, stdin is read */
+                compress_or_decompress = decompress40_mapped;
+        }
+
+        /* per stage time, I/O and block counts go to stderr at the end */
+        if (stats) {
+                Stats_start();
+        }
+
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
                 assert(fp != NULL);
@@ -48,5 +86,10 @@ int main(int argc, char *argv[])
                 compress_or_decompress(stdin);
         }
 
+        if (stats) {
+                fflush(stdout);
+                Stats_report(stderr, statsJson);
+        }
+
         return EXIT_SUCCESS; 
 }
\ No newline at end of file
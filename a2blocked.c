@@ -2,6 +2,8 @@
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "a2spans.h"
+#include "parallel.h"
 
 // define a private version of each function in A2Methods_T that we implement
 
@@ -72,6 +74,89 @@ static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
 	UArray2b_map(a2, apply_small, &mycl);
 }
 
+// each row of a block is contiguous, so a span is at most one block wide
+
+static void map_rows(A2 array2, A2Methods_spanfun apply, void *cl)
+{
+	int width = UArray2b_width(array2);
+	int height = UArray2b_height(array2);
+	int bs = UArray2b_blocksize(array2);
+
+	for (int row = 0; row < height; row++) {
+		for (int left = 0; left < width; left += bs) {
+			int length = (width - left < bs) ? width - left : bs;
+			apply(left, row, length, UArray2b_at(array2, left, row),
+			      array2, cl);
+		}
+	}
+}
+
+// block major, like map_block_major: one span per row of each block
+
+static void map_spans(A2 array2, A2Methods_spanfun apply, void *cl)
+{
+	int width = UArray2b_width(array2);
+	int height = UArray2b_height(array2);
+	int bs = UArray2b_blocksize(array2);
+
+	for (int top = 0; top < height; top += bs) {
+		int rows = (height - top < bs) ? height - top : bs;
+		for (int left = 0; left < width; left += bs) {
+			int length = (width - left < bs) ? width - left : bs;
+			for (int row = top; row < top + rows; row++) {
+				apply(left, row, length,
+				      UArray2b_at(array2, left, row), array2,
+				      cl);
+			}
+		}
+	}
+}
+
+struct parallel_closure {
+	A2 array2;
+	A2Methods_applyfun *apply;
+	void *cl;
+};
+
+// band function of map_parallel: blocks [first, last) in block major order
+
+static void apply_blocks(int first, int last, void *vcl)
+{
+	struct parallel_closure *cl = vcl;
+	int width = UArray2b_width(cl->array2);
+	int height = UArray2b_height(cl->array2);
+	int size = UArray2b_size(cl->array2);
+	int bs = UArray2b_blocksize(cl->array2);
+	int blocksWide = (width + bs - 1) / bs;
+
+	for (int block = first; block < last; block++) {
+		int left = (block % blocksWide) * bs;
+		int top = (block / blocksWide) * bs;
+		int cols = (width - left < bs) ? width - left : bs;
+		int rows = (height - top < bs) ? height - top : bs;
+
+		for (int row = top; row < top + rows; row++) {
+			char *cell = UArray2b_at(cl->array2, left, row);
+			for (int col = left; col < left + cols; col++) {
+				cl->apply(col, row, cl->array2, cell, cl->cl);
+				cell += size;
+			}
+		}
+	}
+}
+
+// blocks are spread over the thread pool, see Parallel_map_bands
+
+static void map_parallel(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	struct parallel_closure mycl = { array2, apply, cl };
+	int bs = UArray2b_blocksize(array2);
+	int blocksWide = (UArray2b_width(array2) + bs - 1) / bs;
+	int blocksHigh = (UArray2b_height(array2) + bs - 1) / bs;
+
+	Parallel_map_bands(blocksWide * blocksHigh, apply_blocks, &mycl);
+}
+
 static struct A2Methods_T uarray2_methods_blocked_struct = {
 	new,
 	new_with_blocksize,
@@ -94,3 +179,11 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
+
+static struct A2Methods_spans_T uarray2_spans_blocked_struct = {
+	map_rows,
+	map_spans,
+	map_parallel,
+};
+
+A2Methods_spans_T uarray2_spans_blocked = &uarray2_spans_blocked_struct;
@@ -9,8 +9,11 @@
 
 #include <a2plain.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "uarray2.h"
+#include "a2spans.h"
+#include "parallel.h"
 
 /************************************************/
 /* Define a private version of each function in */
@@ -121,6 +124,67 @@ static void small_map_col_major(A2Methods_UArray2        a2,
         UArray2_map_col_major(a2, apply_small, &mycl);
 }
 
+/* Calls apply once per row, in row major order, with the whole row; a row
+ * that UArray2 does not store contiguously is passed one cell at a time.
+ * This is also the default span order of a plain array.
+ */
+static void map_rows(A2Methods_UArray2 uarray2, A2Methods_spanfun apply,
+                     void *cl)
+{
+        int width = UArray2_width(uarray2);
+        int height = UArray2_height(uarray2);
+        intptr_t size = UArray2_size(uarray2);
+        if (width == 0) {
+                return;
+        }
+
+        for (int row = 0; row < height; row++) {
+                char *first = UArray2_at(uarray2, 0, row);
+                char *last = UArray2_at(uarray2, width - 1, row);
+
+                if (last - first == (width - 1) * size) {
+                        apply(0, row, width, first, uarray2, cl);
+                        continue;
+                }
+                for (int col = 0; col < width; col++) {
+                        apply(col, row, 1, UArray2_at(uarray2, col, row), 
+                              uarray2, cl);
+                }
+        }
+}
+
+struct parallel_closure {
+        A2Methods_UArray2 uarray2;
+        A2Methods_applyfun *apply;
+        void *cl;
+};
+
+/* Band function of map_parallel: applies to every cell of rows 
+ * [firstRow, lastRow), in row major order.
+ */
+static void apply_rows(int firstRow, int lastRow, void *vcl)
+{
+        struct parallel_closure *cl = vcl;
+        int width = UArray2_width(cl->uarray2);
+
+        for (int row = firstRow; row < lastRow; row++) {
+                for (int col = 0; col < width; col++) {
+                        cl->apply(col, row, cl->uarray2, 
+                                  UArray2_at(cl->uarray2, col, row), cl->cl);
+                }
+        }
+}
+
+/* Spreads the rows over the thread pool, see Parallel_map_bands; apply 
+ * must be safe to call from several threads at once.
+ */
+static void map_parallel(A2Methods_UArray2 uarray2, A2Methods_applyfun apply,
+                         void *cl)
+{
+        struct parallel_closure mycl = { uarray2, apply, cl };
+        Parallel_map_bands(UArray2_height(uarray2), apply_rows, &mycl);
+}
+
 static struct A2Methods_T uarray2_methods_plain_struct = {
         new,
         new_with_blocksize,
@@ -143,3 +207,11 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
 /* finally the payoff: here is the exported pointer to the struct */
 
 A2Methods_T uarray2_methods_plain = &uarray2_methods_plain_struct;
+
+static struct A2Methods_spans_T uarray2_spans_plain_struct = {
+        map_rows,
+        map_rows,               /* map_spans */
+        map_parallel,
+};
+
+A2Methods_spans_T uarray2_spans_plain = &uarray2_spans_plain_struct;
@@ -0,0 +1,73 @@
+/*
+ *     a2spans.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the span and parallel mapping extension of the 
+ *      A2Methods suites. Instead of one apply call per element, a span map
+ *      calls its apply function once per contiguous run of elements in a 
+ *      row, with a pointer to the first element and the length of the run,
+ *      so a stage can loop (and vectorize) over the whole run. A parallel 
+ *      map calls an ordinary apply function from several threads at once.
+ *      a2methods.h is shared with other programs, so these maps live in 
+ *      their own suites, next to uarray2_methods_plain and 
+ *      uarray2_methods_blocked.
+ *
+ */
+
+#ifndef A2SPANS_H
+#define A2SPANS_H
+
+#include <stdint.h>
+#include "assert.h"
+#include "a2methods.h"
+
+/* apply function for a run of length elements of one row: elems points to
+ * the element at (col, row), the next one is at (col + 1, row), and so on
+ */
+typedef void A2Methods_spanfun(int col, int row, int length, void *elems,
+                               A2Methods_UArray2 array2, void *cl);
+typedef void A2Methods_spanmapfun(A2Methods_UArray2 array2,
+                                  A2Methods_spanfun apply, void *cl);
+
+typedef struct A2Methods_spans_T {
+        /* visits every element in row major order; runs never cross rows */
+        A2Methods_spanmapfun *map_rows;
+
+        /* visits every element in the suite's default order, in the
+         * longest runs the layout allows
+         */
+        A2Methods_spanmapfun *map_spans;
+
+        /* visits every element once, in no particular order, from 
+         * Parallel_threads() threads (see parallel.h): rows of a plain 
+         * array or blocks of a blocked one are spread over the threads, so
+         * apply must be safe to call concurrently on different elements
+         */
+        A2Methods_mapfun *map_parallel;
+} *A2Methods_spans_T;
+
+extern A2Methods_spans_T uarray2_spans_plain;
+extern A2Methods_spans_T uarray2_spans_blocked;
+
+/* A2Methods_span_at
+ * Purpose: at() for a whole run: finds the element at (col, row) and checks
+ *              that the next length - 1 elements of the row follow it in
+ *              memory, so a span apply function can read a source array
+ *              with the same layout as its destination in one go
+ * Parameters: methods suite, array, first column, row, length of the run
+ * Returns: pointer to the first element of the run
+ */
+static inline void *A2Methods_span_at(A2Methods_T methods,
+                                      A2Methods_UArray2 array2, int col,
+                                      int row, int length)
+{
+        char *first = methods->at(array2, col, row);
+        char *last = methods->at(array2, col + length - 1, row);
+        assert(last - first == (intptr_t) (length - 1) *
+                               methods->size(array2));
+
+        return first;
+}
+
+#endif
@@ -9,10 +9,14 @@
 
 
 #include "bitpack.h"
+#include "fastbitpack.h"
+#include "codeword.h"
+#include "dct.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "except.h"
 
 void fits_tests();
@@ -26,6 +30,10 @@ void test_bitpack_newu(uint64_t word, unsigned width,
                        unsigned lsb, uint64_t value);
 void test_bitpack_news(uint64_t word, unsigned width, 
                        unsigned lsb, int64_t value);
+void fast_tests();
+uint64_t next_random(uint64_t *state);
+void codeword_tests();
+void bulk_tests();
 
 int main()
 {
@@ -35,6 +43,12 @@ int main()
 
         new_tests();
 
+        fast_tests();
+
+        codeword_tests();
+
+        bulk_tests();
+
         return 0;
 }
 
@@ -191,3 +205,148 @@ void test_bitpack_news(uint64_t word, unsigned width, unsigned lsb, int64_t valu
         int64_t get_value = Bitpack_gets(newWord, width, lsb);
         printf("get s is returning %ld\n", get_value);
 }
+
+/* fast_tests
+ * Purpose: checks the unchecked fastbitpack.h functions against the 
+ *              checked ones on random words and values, for every width 
+ *              up to 32 (the checked fits functions compute their limits in
+ *              32 bit ints) and every lsb, prints the number of mismatches
+ * Parameters: n/a
+ * Returns: n/a
+ */
+void fast_tests()
+{
+        printf("\n----FAST BITPACK TESTING----\n");
+
+        uint64_t state = 40;
+        unsigned mismatches = 0;
+
+        for (unsigned width = 1; width <= 32; width++) {
+                for (unsigned lsb = 0; width + lsb <= 64; lsb++) {
+                        for (int i = 0; i < 16; i++) {
+                                uint64_t word = next_random(&state);
+                                uint64_t bits = next_random(&state);
+                                uint64_t u = bits & Bitpack_mask_fast(width);
+                                int64_t s = Bitpack_gets_fast(bits, width, 0);
+
+                                if (Bitpack_getu_fast(word, width, lsb) != 
+                                    Bitpack_getu(word, width, lsb) ||
+                                    Bitpack_gets_fast(word, width, lsb) != 
+                                    Bitpack_gets(word, width, lsb) ||
+                                    Bitpack_newu_fast(word, width, lsb, u) != 
+                                    Bitpack_newu(word, width, lsb, u) ||
+                                    Bitpack_news_fast(word, width, lsb, s) != 
+                                    Bitpack_news(word, width, lsb, s)) {
+                                        mismatches++;
+                                }
+                        }
+                }
+        }
+
+        printf("%u mismatches with the checked functions\n", mismatches);
+}
+
+/* next_random
+ * Purpose: xorshift generator, so the tests are the same every run
+ * Parameters: generator state
+ * Returns: 64 random bits
+ */
+uint64_t next_random(uint64_t *state)
+{
+        uint64_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *state = x;
+        return x;
+}
+
+/* codeword_tests
+ * Purpose: checks that unpacking then repacking gives back the codeword,
+ *              and that Codeword_pack matches the checked Bitpack calls, 
+ *              on every 257th of the 2^32 codewords
+ * Parameters: n/a
+ * Returns: n/a
+ */
+void codeword_tests()
+{
+        printf("\n----CODEWORD LAYOUT TESTING----\n");
+
+        uint64_t mismatches = 0;
+
+        for (uint64_t n = 0; n <= UINT32_MAX; n += 257) {
+                uint32_t word = (uint32_t) n;
+                uint32_t repacked = Codeword_pack(Codeword_a(word), 
+                                        Codeword_b(word), Codeword_c(word), 
+                                        Codeword_d(word), Codeword_pb(word), 
+                                        Codeword_pr(word));
+                if (repacked != word) {
+                        mismatches++;
+                }
+
+                uint64_t checked = 0;
+                checked = Bitpack_newu(checked, 6, 26, Codeword_a(word));
+                checked = Bitpack_news(checked, 6, 20, Codeword_b(word));
+                checked = Bitpack_news(checked, 6, 14, Codeword_c(word));
+                checked = Bitpack_news(checked, 6, 8, Codeword_d(word));
+                checked = Bitpack_newu(checked, 4, 4, Codeword_pb(word));
+                checked = Bitpack_newu(checked, 4, 0, Codeword_pr(word));
+                if (checked != word) {
+                        mismatches++;
+                }
+        }
+
+        printf("%lu codewords did not round trip\n", mismatches);
+}
+
+/* bulk_tests
+ * Purpose: checks the bulk Codeword functions against the one at a time 
+ *              ones on random codewords, with and without the big endian 
+ *              byte swap, for every batch size up to ROW_CHUNK
+ * Parameters: n/a
+ * Returns: n/a
+ */
+void bulk_tests()
+{
+        printf("\n----BULK CODEWORD TESTING (%s)----\n", Codeword_kernel());
+
+        uint64_t state = 40;
+        unsigned mismatches = 0;
+        uint32_t words[ROW_CHUNK], packed[ROW_CHUNK];
+        unsigned char bytes[4 * ROW_CHUNK], packedBytes[4 * ROW_CHUNK];
+        struct DCT_quant_batch quant, quantBe;
+
+        for (int n = 0; n <= ROW_CHUNK; n++) {
+                for (int k = 0; k < n; k++) {
+                        words[k] = (uint32_t) next_random(&state);
+                }
+                Codeword_to_bigendian(words, n, bytes);
+                Codeword_unpack_batch(words, n, &quant);
+                Codeword_unpack_batch_be(bytes, n, &quantBe);
+                Codeword_pack_batch(&quant, n, packed);
+                Codeword_pack_batch_be(&quantBe, n, packedBytes);
+
+                for (int k = 0; k < n; k++) {
+                        uint32_t w = words[k];
+                        uint32_t fromBytes = ((uint32_t) bytes[4 * k] << 24) |
+                                        ((uint32_t) bytes[4 * k + 1] << 16) |
+                                        ((uint32_t) bytes[4 * k + 2] << 8) | 
+                                        bytes[4 * k + 3];
+                        if (fromBytes != w || packed[k] != w ||
+                            memcmp(&packedBytes[4 * k], &bytes[4 * k], 4) ||
+                            quant.a[k] != Codeword_a(w) || 
+                            quant.b[k] != Codeword_b(w) ||
+                            quant.c[k] != Codeword_c(w) || 
+                            quant.d[k] != Codeword_d(w) ||
+                            quant.pb[k] != Codeword_pb(w) || 
+                            quant.pr[k] != Codeword_pr(w) ||
+                            quantBe.a[k] != quant.a[k] || 
+                            quantBe.d[k] != quant.d[k]) {
+                                mismatches++;
+                        }
+                }
+        }
+
+        printf("%u mismatches with the one at a time functions\n", 
+               mismatches);
+}
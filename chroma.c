@@ -0,0 +1,263 @@
+/*
+ *     chroma.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the table driven chroma 
+ *      quantizer whose declarations are included in chroma.h.
+ *
+ *     Arith40_index_of_chroma picks the nearest of 16 chroma levels, so as
+ *      x grows its answer only ever steps up, at 15 fixed thresholds. 
+ *      Those thresholds are found once by bisecting the library function
+ *      over every (ordered) float, so counting the thresholds at or below
+ *      x gives the library's answer for every float. The count is a 4 step
+ *      branchless binary search (scalar and AVX2) or 15 compares (SSE2). 
+ *      NaN, which has no place in the order, gets whatever the library 
+ *      returns for it.
+ *     
+ */ 
+
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "assert.h"
+#include "arith40.h"
+#include "chroma.h"
+#include "floatkey.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define NUM_CHROMA 16
+
+/* thresholds[j] is the smallest float with index min_index + j + 1 or more;
+ * the last slot (and any unused ones) hold +infinity 
+ */
+static float thresholds[NUM_CHROMA];
+static unsigned min_index;
+static unsigned nan_index;
+static float levels[NUM_CHROMA];
+
+typedef void index_batch_fun(const float *chroma, uint32_t *indices, int n);
+typedef void level_batch_fun(const uint32_t *indices, float *chroma, int n);
+
+static index_batch_fun index_batch_scalar;
+static level_batch_fun level_batch_scalar;
+
+static index_batch_fun *index_batch = index_batch_scalar;
+static level_batch_fun *level_batch = level_batch_scalar;
+static pthread_once_t chroma_once = PTHREAD_ONCE_INIT;
+
+static void setup(void);
+static inline unsigned index_of(float x);
+
+/* Chroma_index_of
+ * Purpose: quantizes one chroma value, same as Arith40_index_of_chroma
+ * Parameters: chroma value
+ * Returns: index of the nearest chroma level
+ */
+unsigned Chroma_index_of(float x)
+{
+        pthread_once(&chroma_once, setup);
+        return index_of(x);
+}
+
+/* Chroma_of_index
+ * Purpose: unquantizes one chroma index, same as Arith40_chroma_of_index
+ * Parameters: 4 bit chroma index
+ * Returns: chroma level
+ */
+float Chroma_of_index(unsigned n)
+{
+        assert(n < NUM_CHROMA);
+        pthread_once(&chroma_once, setup);
+        return levels[n];
+}
+
+/* Chroma_index_batch
+ * Purpose: quantizes n chroma values
+ * Parameters: chroma values, destination indices, count
+ * Returns: N/A
+ */
+void Chroma_index_batch(const float *chroma, uint32_t *indices, int n)
+{
+        pthread_once(&chroma_once, setup);
+        index_batch(chroma, indices, n);
+}
+
+/* Chroma_of_index_batch
+ * Purpose: unquantizes n 4 bit chroma indices
+ * Parameters: indices, destination chroma values, count
+ * Returns: N/A
+ */
+void Chroma_of_index_batch(const uint32_t *indices, float *chroma, int n)
+{
+        pthread_once(&chroma_once, setup);
+        level_batch(indices, chroma, n);
+}
+
+/* index_of
+ * Purpose: counts the thresholds at or below x, 4 step binary search
+ */
+static inline unsigned index_of(float x)
+{
+        if (isnan(x)) {
+                return nan_index;
+        }
+
+        unsigned count = 0;
+        for (unsigned step = NUM_CHROMA / 2; step >= 1; step /= 2) {
+                if (x >= thresholds[count + step - 1]) {
+                        count += step;
+                }
+        }
+
+        return min_index + count;
+}
+
+static void index_batch_scalar(const float *chroma, uint32_t *indices, int n)
+{
+        for (int i = 0; i < n; i++) {
+                indices[i] = index_of(chroma[i]);
+        }
+}
+
+static void level_batch_scalar(const uint32_t *indices, float *chroma, int n)
+{
+        for (int i = 0; i < n; i++) {
+                chroma[i] = levels[indices[i] & (NUM_CHROMA - 1)];
+        }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* index_batch_sse2
+ * Purpose: 4 values per iteration, compared against all 15 thresholds 
+ *              (a true compare is all ones, so subtracting it counts it)
+ */
+__attribute__((target("sse2")))
+static void index_batch_sse2(const float *chroma, uint32_t *indices, int n)
+{
+        const __m128i base = _mm_set1_epi32(min_index);
+        const __m128i nanIndex = _mm_set1_epi32(nan_index);
+        int i = 0;
+
+        for (; i + 4 <= n; i += 4) {
+                __m128 x = _mm_loadu_ps(&chroma[i]);
+                __m128i count = base;
+                for (int j = 0; j < NUM_CHROMA - 1; j++) {
+                        __m128 atLeast = _mm_cmpge_ps(x, 
+                                                _mm_set1_ps(thresholds[j]));
+                        count = _mm_sub_epi32(count, 
+                                              _mm_castps_si128(atLeast));
+                }
+                __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(x, x));
+                count = _mm_or_si128(_mm_andnot_si128(isNan, count), 
+                                     _mm_and_si128(isNan, nanIndex));
+                _mm_storeu_si128((__m128i *) &indices[i], count);
+        }
+        index_batch_scalar(chroma + i, indices + i, n - i);
+}
+
+/* index_batch_avx2
+ * Purpose: 8 values per iteration, 4 step branchless binary search 
+ */
+__attribute__((target("avx2")))
+static void index_batch_avx2(const float *chroma, uint32_t *indices, int n)
+{
+        const __m256i base = _mm256_set1_epi32(min_index);
+        const __m256i nanIndex = _mm256_set1_epi32(nan_index);
+        const __m256i one = _mm256_set1_epi32(1);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                __m256 x = _mm256_loadu_ps(&chroma[i]);
+                __m256i count = _mm256_setzero_si256();
+                for (int step = NUM_CHROMA / 2; step >= 1; step /= 2) {
+                        __m256i next = _mm256_add_epi32(count, 
+                                                _mm256_set1_epi32(step));
+                        __m256 threshold = _mm256_i32gather_ps(thresholds, 
+                                        _mm256_sub_epi32(next, one), 4);
+                        __m256 atLeast = _mm256_cmp_ps(x, threshold, 
+                                                       _CMP_GE_OQ);
+                        count = _mm256_blendv_epi8(count, next, 
+                                        _mm256_castps_si256(atLeast));
+                }
+                count = _mm256_add_epi32(count, base);
+                __m256 isNan = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+                count = _mm256_blendv_epi8(count, nanIndex, 
+                                           _mm256_castps_si256(isNan));
+                _mm256_storeu_si256((__m256i *) &indices[i], count);
+        }
+        index_batch_scalar(chroma + i, indices + i, n - i);
+}
+
+/* level_batch_avx2
+ * Purpose: 8 table lookups per iteration with one gather
+ */
+__attribute__((target("avx2")))
+static void level_batch_avx2(const uint32_t *indices, float *chroma, int n)
+{
+        const __m256i mask = _mm256_set1_epi32(NUM_CHROMA - 1);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                __m256i index = _mm256_and_si256(mask, 
+                        _mm256_loadu_si256((const __m256i *) &indices[i]));
+                _mm256_storeu_ps(&chroma[i], 
+                                 _mm256_i32gather_ps(levels, index, 4));
+        }
+        level_batch_scalar(indices + i, chroma + i, n - i);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* setup
+ * Purpose: builds the tables from the arith40 functions and picks the 
+ *              batch kernels, run once
+ */
+static void setup(void)
+{
+        for (unsigned n = 0; n < NUM_CHROMA; n++) {
+                levels[n] = Arith40_chroma_of_index(n);
+        }
+
+        min_index = Arith40_index_of_chroma(-INFINITY);
+        unsigned max_index = Arith40_index_of_chroma(INFINITY);
+        nan_index = Arith40_index_of_chroma(NAN);
+        assert(max_index >= min_index && max_index < NUM_CHROMA);
+
+        for (unsigned j = 0; j < NUM_CHROMA; j++) {
+                unsigned index = min_index + j + 1;
+                if (index > max_index) {
+                        thresholds[j] = INFINITY;
+                        continue;
+                }
+
+                /* smallest float that quantizes to index or more */
+                uint32_t low = Floatkey_of(-INFINITY);
+                uint32_t high = Floatkey_of(INFINITY);
+                while (low < high) {
+                        uint32_t mid = low + (high - low) / 2;
+                        float x = Floatkey_float(mid);
+                        if (Arith40_index_of_chroma(x) >= index) {
+                                high = mid;
+                        } else {
+                                low = mid + 1;
+                        }
+                }
+                thresholds[j] = Floatkey_float(low);
+        }
+
+#ifdef HAVE_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                index_batch = index_batch_avx2;
+                level_batch = level_batch_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+                index_batch = index_batch_sse2;
+        }
+#endif
+}
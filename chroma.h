@@ -0,0 +1,25 @@
+/*
+ *     chroma.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the table driven chroma 
+ *      quantizer. It gives exactly the same answers as 
+ *      Arith40_index_of_chroma and Arith40_chroma_of_index, from small 
+ *      tables built once from those functions, one value at a time or a
+ *      whole array at a time.
+ *     
+ */ 
+
+#ifndef CHROMA_H
+#define CHROMA_H
+
+#include <stdint.h>
+
+unsigned Chroma_index_of(float x);
+float Chroma_of_index(unsigned n);
+
+void Chroma_index_batch(const float *chroma, uint32_t *indices, int n);
+void Chroma_of_index_batch(const uint32_t *indices, float *chroma, int n);
+
+#endif
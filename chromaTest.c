@@ -0,0 +1,124 @@
+/*
+ *     chromaTest.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the unit test functions for chroma.c. Every one 
+ *      of the 2^32 float bit patterns (NaNs and infinities included) is 
+ *      quantized with both the chroma tables and arith40, one at a time 
+ *      and in batches, and every index is unquantized both ways. Exits 
+ *      with 1 if any answer differs.
+ *     
+ */ 
+
+
+#include "chroma.h"
+#include "arith40.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH 1024
+
+uint64_t index_tests();
+uint64_t level_tests();
+uint64_t test_index_batch(uint32_t firstBits);
+
+int main()
+{
+        uint64_t mismatches = 0;
+
+        printf("\n----CHROMA OF INDEX TESTING----\n");
+        mismatches += level_tests();
+
+        printf("\n----INDEX OF CHROMA TESTING----\n");
+        mismatches += index_tests();
+
+        printf("\n%lu mismatches in total\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+}
+
+/* level_tests
+ * Purpose: compares Chroma_of_index and Chroma_of_index_batch with 
+ *              Arith40_chroma_of_index on all 16 indices
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t level_tests()
+{
+        uint64_t mismatches = 0;
+        uint32_t indices[16];
+        float batch[16];
+
+        for (unsigned n = 0; n < 16; n++) {
+                indices[n] = n;
+        }
+        Chroma_of_index_batch(indices, batch, 16);
+
+        for (unsigned n = 0; n < 16; n++) {
+                float expected = Arith40_chroma_of_index(n);
+                float single = Chroma_of_index(n);
+                if (memcmp(&single, &expected, sizeof(float)) != 0 ||
+                    memcmp(&batch[n], &expected, sizeof(float)) != 0) {
+                        printf("index %u: expected %a, got %a and %a\n", 
+                               n, expected, single, batch[n]);
+                        mismatches++;
+                }
+        }
+
+        printf("%lu mismatches over 16 indices\n", mismatches);
+        return mismatches;
+}
+
+/* index_tests
+ * Purpose: compares Chroma_index_of and Chroma_index_batch with 
+ *              Arith40_index_of_chroma on every float bit pattern
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t index_tests()
+{
+        uint64_t mismatches = 0;
+
+        for (uint64_t bits = 0; bits <= UINT32_MAX; bits += BATCH) {
+                mismatches += test_index_batch((uint32_t) bits);
+        }
+
+        printf("%lu mismatches over 2^32 floats\n", mismatches);
+        return mismatches;
+}
+
+/* test_index_batch
+ * Purpose: checks BATCH consecutive bit patterns, prints the first few 
+ *              mismatches
+ * Parameters: bit pattern of the first float
+ * Returns: number of mismatches
+ */
+uint64_t test_index_batch(uint32_t firstBits)
+{
+        static uint64_t printed = 0;
+        uint64_t mismatches = 0;
+        float chroma[BATCH];
+        uint32_t batch[BATCH];
+
+        for (uint32_t i = 0; i < BATCH; i++) {
+                uint32_t bits = firstBits + i;
+                memcpy(&chroma[i], &bits, sizeof(float));
+        }
+        Chroma_index_batch(chroma, batch, BATCH);
+
+        for (uint32_t i = 0; i < BATCH; i++) {
+                unsigned expected = Arith40_index_of_chroma(chroma[i]);
+                unsigned single = Chroma_index_of(chroma[i]);
+                if (single != expected || batch[i] != expected) {
+                        if (printed++ < 10) {
+                                printf("%a: expected %u, got %u and %u\n", 
+                                       chroma[i], expected, single, batch[i]);
+                        }
+                        mismatches++;
+                }
+        }
+
+        return mismatches;
+}
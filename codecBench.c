@@ -0,0 +1,461 @@
+/*
+ *     codecBench.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the codec benchmark run by `make bench`. It
+ *      generates synthetic images in memory (noise, smooth gradients, and
+ *      photographic-like content: soft shading, flat objects with sharp
+ *      edges, and a little sensor noise) of the requested sizes, then runs
+ *      compressedImage and decompressedImage on each, timing every stage
+ *      separately through the stage markers (see stages.h). The fused
+ *      engines are timed as a whole for comparison. For every stage it
+ *      reports the time, megapixels per second, the number of allocations
+ *      made and the bytes they asked for, and the most memory held at once;
+ *      for every pipeline, also the peak resident set size. Results are
+ *      written to standard output as JSON.
+ *
+ *     Allocations and memory are the ones made through mem.h, as counted
+ *      by memtrack (see memtrack.h). The peak resident set size is reset
+ *      before every pipeline where Linux allows it (/proc/self/clear_refs),
+ *      otherwise it is the peak of the process.
+ *
+ *     Usage: codec_bench [-s megapixels,...] [-k kind,...] [-r repetitions]
+ *            codec_bench -g kind megapixels > image.ppm
+ *            (kinds: noise, gradient, photo; default -s 1,4,16, all kinds,
+ *             -r 1; -g writes one synthetic image instead)
+ *
+ */
+
+#include "compression.h"
+#include "stages.h"
+#include "memtrack.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <mem.h>
+
+#define MAX_STAGES 16
+#define MAX_SIZES 16
+
+/* one stage of a pipeline run */
+struct stage_result {
+        const char *name;
+        double seconds;
+        uint64_t bytes;
+        uint64_t allocations;
+        uint64_t peakBytes;
+};
+
+/* everything measured about one run of one pipeline, filled in by the
+ * stage hook as the stages finish
+ */
+struct run {
+        double last;
+        uint64_t lastBytes, lastAllocations;
+        int numStages;
+        struct stage_result stages[MAX_STAGES];
+};
+
+void record_stage(const char *stage, void *cl);
+void start_run(struct run *run);
+Pnm_ppm synthetic_image(const char *kind, double megapixels);
+void fill_pixel(const char *kind, int col, int row, int width, int height,
+                uint64_t *state, Pnm_rgb pixel);
+uint64_t next_random(uint64_t *state);
+void write_image(Pnm_ppm image, FILE *output);
+void bench_image(const char *kind, double megapixels, int reps,
+                 bool *first);
+void print_run(const char *kind, Pnm_ppm image, const char *pipeline,
+               struct run *run, long peakRss, bool *first);
+void reset_peak_rss(void);
+long peak_rss_bytes(void);
+
+int main(int argc, char *argv[])
+{
+        const char *sizes = "1,4,16";
+        const char *kinds = "noise,gradient,photo";
+        int reps = 1;
+
+        if (argc == 4 && strcmp(argv[1], "-g") == 0) {
+                Pnm_ppm image = synthetic_image(argv[2], atof(argv[3]));
+                write_image(image, stdout);
+                Pnm_ppmfree(&image);
+                return EXIT_SUCCESS;
+        }
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        sizes = argv[++i];
+                } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+                        kinds = argv[++i];
+                } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+                        reps = atoi(argv[++i]);
+                } else {
+                        fprintf(stderr, "Usage: %s [-s megapixels,...] "
+                                "[-k kind,...] [-r repetitions]\n"
+                                "       %s -g kind megapixels > image.ppm\n",
+                                argv[0], argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+        }
+        assert(reps >= 1);
+
+        bool first = true;
+        printf("{\n  \"benchmark\": \"codec\",\n  \"repetitions\": %d,\n"
+               "  \"runs\": [", reps);
+
+        char kindList[256];
+        snprintf(kindList, sizeof(kindList), "%s", kinds);
+        for (char *kind = strtok(kindList, ","); kind != NULL;
+             kind = strtok(NULL, ",")) {
+                const char *size = sizes;
+                while (*size != '\0') {
+                        double megapixels = strtod(size, (char **) &size);
+                        assert(megapixels > 0);
+                        bench_image(kind, megapixels, reps, &first);
+                        if (*size == ',') {
+                                size++;
+                        }
+                }
+        }
+
+        printf("\n  ]\n}\n");
+        return EXIT_SUCCESS;
+}
+
+/* bench_image
+ * Purpose: generates one image, then runs and reports the staged and the
+ *              fused compressor and decompressor on it, keeping the
+ *              fastest of reps runs of each
+ * Parameters: kind of image, size in megapixels, repetitions, whether no
+ *              run has been printed yet
+ * Returns: N/A
+ */
+void bench_image(const char *kind, double megapixels, int reps, bool *first)
+{
+        Pnm_ppm image = synthetic_image(kind, megapixels);
+        const char *pipelines[4] = { "staged_compress", "staged_decompress",
+                                     "fused_compress", "fused_decompress" };
+        A2Methods_UArray2 codewords = fusedCompressedImage(image);
+
+        for (int p = 0; p < 4; p++) {
+                struct run best = { .numStages = 0 };
+                double bestSeconds = 1e30;
+                long peakRss = 0;
+
+                for (int r = 0; r < reps; r++) {
+                        struct run run;
+                        A2Methods_UArray2 result;
+
+                        reset_peak_rss();
+                        start_run(&run);
+                        Stages_set_hook(record_stage, &run);
+                        if (p == 0) {
+                                result = compressedImage(image);
+                        } else if (p == 1) {
+                                result = decompressedImage(codewords);
+                        } else if (p == 2) {
+                                result = fusedCompressedImage(image);
+                                record_stage("fused_compress", &run);
+                        } else {
+                                result = fusedDecompressedImage(codewords);
+                                record_stage("fused_decompress", &run);
+                        }
+                        Stages_set_hook(NULL, NULL);
+                        peakRss = peak_rss_bytes();
+                        uarray2_methods_plain->free(&result);
+
+                        double seconds = 0;
+                        for (int s = 0; s < run.numStages; s++) {
+                                seconds += run.stages[s].seconds;
+                        }
+                        if (seconds < bestSeconds) {
+                                bestSeconds = seconds;
+                                best = run;
+                        }
+                }
+                print_run(kind, image, pipelines[p], &best, peakRss, first);
+        }
+
+        uarray2_methods_plain->free(&codewords);
+        Pnm_ppmfree(&image);
+}
+
+/* start_run
+ * Purpose: starts the clock, the allocation counts and the memory peak of
+ *              a run
+ * Parameters: run to start
+ * Returns: N/A
+ */
+void start_run(struct run *run)
+{
+        run->numStages = 0;
+        run->lastBytes = Memtrack_allocated();
+        run->lastAllocations = Memtrack_allocations();
+        Memtrack_start_stage();
+        run->last = Timing_seconds(CLOCK_MONOTONIC);
+}
+
+/* record_stage
+ * Purpose: stage hook: charges the time, allocations and memory peak since
+ *              the last mark to the stage that just finished
+ * Parameters: name of the stage, the run (struct run)
+ * Returns: N/A
+ */
+void record_stage(const char *stage, void *cl)
+{
+        struct run *run = cl;
+        double now = Timing_seconds(CLOCK_MONOTONIC);
+        uint64_t bytes = Memtrack_allocated();
+        uint64_t count = Memtrack_allocations();
+
+        assert(run->numStages < MAX_STAGES);
+        struct stage_result *result = &run->stages[run->numStages++];
+        result->name = stage;
+        result->seconds = now - run->last;
+        result->bytes = bytes - run->lastBytes;
+        result->allocations = count - run->lastAllocations;
+        result->peakBytes = Memtrack_stage_peak();
+
+        run->lastBytes = bytes;
+        run->lastAllocations = count;
+        Memtrack_start_stage();
+        run->last = now;
+}
+
+/* print_run
+ * Purpose: prints one run as a JSON object
+ * Parameters: kind of image, image, pipeline name, measured run, peak
+ *              resident set size, whether no run has been printed yet
+ * Returns: N/A
+ */
+void print_run(const char *kind, Pnm_ppm image, const char *pipeline,
+               struct run *run, long peakRss, bool *first)
+{
+        double megapixels = (double) image->width * image->height / 1e6;
+        double seconds = 0;
+        uint64_t bytes = 0, count = 0, peakBytes = 0;
+        for (int s = 0; s < run->numStages; s++) {
+                seconds += run->stages[s].seconds;
+                bytes += run->stages[s].bytes;
+                count += run->stages[s].allocations;
+                if (run->stages[s].peakBytes > peakBytes) {
+                        peakBytes = run->stages[s].peakBytes;
+                }
+        }
+
+        printf("%s\n    {\"image\": \"%s\", \"width\": %u, \"height\": %u, "
+               "\"megapixels\": %.3f, \"pipeline\": \"%s\",\n",
+               *first ? "" : ",", kind, image->width, image->height,
+               megapixels, pipeline);
+        printf("     \"seconds\": %.6f, \"megapixels_per_second\": %.3f, "
+               "\"bytes_allocated\": %llu, \"allocations\": %llu, "
+               "\"peak_bytes\": %llu, \"peak_rss_bytes\": %ld,\n"
+               "     \"stages\": [",
+               seconds, megapixels / seconds, (unsigned long long) bytes,
+               (unsigned long long) count, (unsigned long long) peakBytes,
+               peakRss);
+        for (int s = 0; s < run->numStages; s++) {
+                struct stage_result *stage = &run->stages[s];
+                printf("%s\n       {\"stage\": \"%s\", \"seconds\": %.6f, "
+                       "\"megapixels_per_second\": %.3f, "
+                       "\"bytes_allocated\": %llu, \"allocations\": %llu, "
+                       "\"peak_bytes\": %llu}",
+                       s == 0 ? "" : ",", stage->name, stage->seconds,
+                       megapixels / stage->seconds,
+                       (unsigned long long) stage->bytes,
+                       (unsigned long long) stage->allocations,
+                       (unsigned long long) stage->peakBytes);
+        }
+        printf("]}");
+        fflush(stdout);
+        *first = false;
+}
+
+/* synthetic_image
+ * Purpose: generates a 4:3 image of about the given size (even width and
+ *              height), always the same for the same kind and size
+ * Parameters: kind (noise, gradient or photo), size in megapixels
+ * Returns: the image, with denominator 255, freed with Pnm_ppmfree
+ */
+Pnm_ppm synthetic_image(const char *kind, double megapixels)
+{
+        assert(strcmp(kind, "noise") == 0 || strcmp(kind, "gradient") == 0 ||
+               strcmp(kind, "photo") == 0);
+        assert(megapixels > 0);
+
+        int width = (int) (sqrt(megapixels * 1e6 * 4 / 3) / 2) * 2;
+        int height = (int) (megapixels * 1e6 / width / 2) * 2;
+        if (width < 2) {
+                width = 2;
+        }
+        if (height < 2) {
+                height = 2;
+        }
+
+        Pnm_ppm image;
+        NEW(image);
+        image->width = width;
+        image->height = height;
+        image->denominator = 255;
+        image->methods = uarray2_methods_plain;
+        image->pixels = uarray2_methods_plain->new(width, height,
+                                                   sizeof(struct Pnm_rgb));
+
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        fill_pixel(kind, col, row, width, height, &state,
+                                   uarray2_methods_plain->at(image->pixels,
+                                                             col, row));
+                }
+        }
+
+        return image;
+}
+
+/* fill_pixel
+ * Purpose: computes one pixel of a synthetic image
+ * Parameters: kind, column, row, width, height, random state, destination
+ * Returns: N/A
+ */
+void fill_pixel(const char *kind, int col, int row, int width, int height,
+                uint64_t *state, Pnm_rgb pixel)
+{
+        double x = (double) col / width;
+        double y = (double) row / height;
+
+        if (kind[0] == 'n') {
+                uint64_t r = next_random(state);
+                pixel->red = r & 0xff;
+                pixel->green = (r >> 8) & 0xff;
+                pixel->blue = (r >> 16) & 0xff;
+                return;
+        }
+        if (kind[0] == 'g') {
+                pixel->red = (unsigned) (255 * x);
+                pixel->green = (unsigned) (255 * y);
+                pixel->blue = (unsigned) (255 * (x + y) / 2);
+                return;
+        }
+
+        /* photo: soft lighting, then a few flat objects, then noise */
+        double light = 0.5 + 0.25 * sin(6.1 * x + 1.3) * cos(4.7 * y - 0.4)
+                           + 0.15 * sin(17.0 * x * y);
+        double red = light * 0.9, green = light * 0.8, blue = light * 0.7;
+
+        double dx = x - 0.35, dy = y - 0.55;
+        if (dx * dx + dy * dy < 0.04) {
+                red = 0.8 * light + 0.15;
+                green = 0.2 * light;
+                blue = 0.1;
+        }
+        if (x > 0.6 && x < 0.85 && y > 0.2 && y < 0.7) {
+                red = 0.1;
+                green = 0.3 + 0.3 * y;
+                blue = 0.6 * light + 0.2;
+        }
+        if (y > 0.85) {
+                red *= 0.5;
+                green = green * 0.5 + 0.25;
+                blue *= 0.5;
+        }
+
+        uint64_t r = next_random(state);
+        double channels[3] = { red, green, blue };
+        unsigned values[3];
+        for (int c = 0; c < 3; c++) {
+                int noise = (int) ((r >> (8 * c)) & 7) - 4;
+                int value = (int) (channels[c] * 255) + noise;
+                values[c] = squash_into_range(0, 255, value);
+        }
+        pixel->red = values[0];
+        pixel->green = values[1];
+        pixel->blue = values[2];
+}
+
+/* next_random
+ * Purpose: xorshift64 pseudo random numbers
+ * Parameters: state, updated
+ * Returns: the next number
+ */
+uint64_t next_random(uint64_t *state)
+{
+        uint64_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *state = x;
+        return x;
+}
+
+/* write_image
+ * Purpose: writes an image with denominator 255 as a raw PPM
+ * Parameters: image, file to write to
+ * Returns: N/A
+ */
+void write_image(Pnm_ppm image, FILE *output)
+{
+        unsigned char *row = ALLOC((long) image->width * 3 + 1);
+
+        Rawppm_write_header(output, image->width, image->height);
+        for (unsigned r = 0; r < image->height; r++) {
+                for (unsigned c = 0; c < image->width; c++) {
+                        Pnm_rgb pixel = image->methods->at(image->pixels,
+                                                           c, r);
+                        row[3 * c] = pixel->red;
+                        row[3 * c + 1] = pixel->green;
+                        row[3 * c + 2] = pixel->blue;
+                }
+                Rawppm_write_rows(output, row, image->width, 1);
+        }
+
+        FREE(row);
+}
+
+/* reset_peak_rss
+ * Purpose: resets the kernel's peak resident set size of the process,
+ *              where Linux supports it
+ * Parameters: N/A
+ * Returns: N/A
+ */
+void reset_peak_rss(void)
+{
+        FILE *fp = fopen("/proc/self/clear_refs", "w");
+        if (fp != NULL) {
+                fputs("5", fp);
+                fclose(fp);
+        }
+}
+
+/* peak_rss_bytes
+ * Purpose: reads the peak resident set size since the last reset
+ *              (VmHWM), or since the process started (getrusage)
+ * Parameters: N/A
+ * Returns: peak resident set size in bytes
+ */
+long peak_rss_bytes(void)
+{
+        char line[256];
+        long kilobytes = -1;
+
+        FILE *fp = fopen("/proc/self/status", "r");
+        if (fp != NULL) {
+                while (fgets(line, sizeof(line), fp) != NULL) {
+                        if (strncmp(line, "VmHWM:", 6) == 0) {
+                                kilobytes = atol(line + 6);
+                        }
+                }
+                fclose(fp);
+        }
+        if (kilobytes < 0) {
+                struct rusage usage;
+                getrusage(RUSAGE_SELF, &usage);
+                kilobytes = usage.ru_maxrss;
+        }
+
+        return kilobytes * 1024;
+}
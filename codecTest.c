@@ -0,0 +1,892 @@
+/*
+ *     codecTest.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the end to end tests of the compressor engines.
+ *      The fused encoders (fusedCompressedImage and fusedCompressedRaw)
+ *      must give the same codewords as the staged compressedImage, byte
+ *      for byte, so every engine is run on the same images and the big
+ *      endian codeword bytes are compared with memcmp. The images have
+ *      odd and even widths and heights (rows of more than ROW_CHUNK blocks
+ *      too), denominators from 1 to 65535 (2 bytes per sample above 255),
+ *      and random, smooth and extreme samples; each is encoded on 1 thread
+ *      for the reference, then on several.
+ *
+ *     The fused decoders (fusedDecompressedImage and fusedDecompressedRaw)
+ *      must likewise give decompressedImage's pixels bit for bit. They are
+ *      run on random codeword arrays and on one holding every combination
+ *      of edge values of the six fields (6/6/6/6/4/4 bits), all with odd
+ *      numbers of blocks, on several thread counts, and the rasters are
+ *      compared.
+ *
+ *     The streaming compressor (compress40_stream, 40image -s -c) must
+ *      write the same file as compress40. Both are run on the test images
+ *      saved as raw PPMs with their own denominators, with standard output
+ *      sent to a temporary file, and the files are compared with the
+ *      compressed format header followed by compressedImage's codewords.
+ *      Likewise the streaming decompressor (decompress40_stream, 40image
+ *      -s -d) and the mapped one must write what decompress40 writes: the
+ *      codeword arrays of the decoder tests are saved as compressed files
+ *      and the PPMs all three write are compared with decompressedImage's
+ *      pixels.
+ *
+ *     Last, images with denominators other than 255 are round tripped and
+ *      compared, as roundtrip_eval compares them, with the original scaled
+ *      to 255 (see Rawppm_rescale). The error must be that of the same
+ *      image saved with denominator 255: comparing samples of different
+ *      scales would show errors in the hundreds or thousands. Exits with 1
+ *      if any output differs or any error is out of line.
+ *
+ */
+
+
+#include "compression.h"
+#include "compress40.h"
+#include "parallel.h"
+#include "codeword.h"
+#include "imagediff.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mem.h>
+
+#define NUM_SIZES 6
+#define NUM_DENOMINATORS 5
+#define NUM_PATTERNS 3
+#define NUM_THREADS 3
+#define NUM_CODEWORD_SIZES 4
+#define NUM_SCALES 2
+/* largest difference allowed between the RMSE of an image and that of
+ * the same image with denominator 255
+ */
+#define RMSE_TOLERANCE 0.5
+/* values tried for every field, and the array that holds all their
+ * combinations (EDGE_VALUES to the 6th power codewords, the rest random)
+ */
+#define EDGE_VALUES 6
+#define EDGE_WIDTH 233
+#define EDGE_HEIGHT 201
+
+static const int sizes[NUM_SIZES][2] = { { 2, 2 }, { 3, 3 }, { 5, 2 },
+                                         { 37, 23 }, { 258, 9 },
+                                         { 259, 131 } };
+static const unsigned denominators[NUM_DENOMINATORS] = { 1, 100, 255, 1023,
+                                                         65535 };
+static const char *patterns[NUM_PATTERNS] = { "random", "smooth",
+                                              "extreme" };
+static const int threads[NUM_THREADS] = { 1, 3, 8 };
+static const int codewordSizes[NUM_CODEWORD_SIZES][2] = { { 1, 1 },
+                                                          { 3, 5 },
+                                                          { 129, 7 },
+                                                          { 131, 65 } };
+static const unsigned scales[NUM_SCALES] = { 100, 65535 };
+static const unsigned edgeA[EDGE_VALUES] = { 0, 1, 31, 32, 62, 63 };
+static const int edgeBCD[EDGE_VALUES] = { -32, -31, -1, 0, 1, 31 };
+static const unsigned edgeChroma[EDGE_VALUES] = { 0, 1, 7, 8, 14, 15 };
+
+uint64_t encoder_tests();
+uint64_t encoder_test(int width, int height, unsigned denominator,
+                      const char *pattern);
+Pnm_ppm test_image(int width, int height, unsigned denominator,
+                   const char *pattern);
+uint64_t decoder_tests();
+uint64_t decoder_test(A2Methods_UArray2 codewords, const char *name);
+A2Methods_UArray2 random_codewords(int width, int height);
+A2Methods_UArray2 edge_codewords();
+uint32_t random_word();
+uint64_t stream_encoder_tests();
+uint64_t stream_encoder_test(int width, int height, unsigned denominator);
+uint64_t stream_decoder_tests();
+uint64_t stream_decoder_test(A2Methods_UArray2 codewords, const char *name);
+uint64_t scale_tests();
+uint64_t scale_test(unsigned denominator, const char *pattern);
+void roundtrip_difference(Pnm_ppm image, Rawppm reference, Imagediff diff);
+FILE *ppm_file(Pnm_ppm image);
+FILE *compressed_file(A2Methods_UArray2 codewords);
+unsigned char *captured_output(void (*run)(FILE *input), FILE *input,
+                               size_t *length);
+uint64_t compare_output(const char *what, const char *image,
+                        const unsigned char *expected, size_t expectedLength,
+                        const unsigned char *actual, size_t actualLength);
+unsigned char *codeword_bytes(A2Methods_UArray2 codewords);
+unsigned char *pixel_bytes(A2Methods_UArray2 pixels);
+unsigned char *poisoned_copy(const unsigned char *expected, size_t n);
+uint64_t compare_bytes(const char *what, const char *image,
+                       const unsigned char *expected,
+                       const unsigned char *actual, size_t n);
+
+int main()
+{
+        uint64_t mismatches = 0;
+        srand(40);
+
+        printf("\n----ENCODER TESTING----\n");
+        mismatches += encoder_tests();
+
+        printf("\n----DECODER TESTING----\n");
+        mismatches += decoder_tests();
+
+        printf("\n----STREAM COMPRESSOR TESTING----\n");
+        mismatches += stream_encoder_tests();
+
+        printf("\n----STREAM DECOMPRESSOR TESTING----\n");
+        mismatches += stream_decoder_tests();
+
+        printf("\n----ROUND TRIP SCALE TESTING----\n");
+        mismatches += scale_tests();
+
+        printf("\n%lu mismatches in total\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+}
+
+/* encoder_tests
+ * Purpose: runs encoder_test on every size, denominator and pattern
+ * Parameters: n/a
+ * Returns: number of outputs that differ
+ */
+uint64_t encoder_tests()
+{
+        uint64_t mismatches = 0;
+        int images = 0;
+
+        for (int s = 0; s < NUM_SIZES; s++) {
+                for (int d = 0; d < NUM_DENOMINATORS; d++) {
+                        for (int p = 0; p < NUM_PATTERNS; p++) {
+                                mismatches += encoder_test(sizes[s][0],
+                                                           sizes[s][1],
+                                                           denominators[d],
+                                                           patterns[p]);
+                                images++;
+                        }
+                }
+        }
+
+        printf("%d images on 1 to %d threads\n", images,
+               threads[NUM_THREADS - 1]);
+        printf("%lu mismatches with compressedImage\n", mismatches);
+        return mismatches;
+}
+
+/* encoder_test
+ * Purpose: encodes one test image with compressedImage on one thread,
+ *              then with compressedImage, fusedCompressedImage and
+ *              fusedCompressedRaw on every thread count, and compares
+ *              their codewords with the first
+ * Parameters: width, height, denominator and pattern of the image
+ * Returns: number of outputs that differ
+ */
+uint64_t encoder_test(int width, int height, unsigned denominator,
+                      const char *pattern)
+{
+        uint64_t mismatches = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "%s %dx%d /%u", pattern, width, height,
+                 denominator);
+
+        Pnm_ppm image = test_image(width, height, denominator, pattern);
+        struct Rawppm raw;
+        Rawppm_from_pnm(image, &raw);
+        size_t length = (size_t) (width / 2) * (height / 2) * 4;
+
+        Parallel_set_threads(1);
+        A2Methods_UArray2 codewords = compressedImage(image);
+        unsigned char *expected = codeword_bytes(codewords);
+        uarray2_methods_plain->free(&codewords);
+
+        for (int t = 0; t < NUM_THREADS; t++) {
+                Parallel_set_threads(threads[t]);
+
+                codewords = compressedImage(image);
+                unsigned char *actual = codeword_bytes(codewords);
+                mismatches += compare_bytes("compressedImage", name,
+                                            expected, actual, length);
+                FREE(actual);
+                uarray2_methods_plain->free(&codewords);
+
+                codewords = fusedCompressedImage(image);
+                actual = codeword_bytes(codewords);
+                mismatches += compare_bytes("fusedCompressedImage", name,
+                                            expected, actual, length);
+                FREE(actual);
+                uarray2_methods_plain->free(&codewords);
+
+                actual = poisoned_copy(expected, length);
+                fusedCompressedRaw(&raw, actual);
+                mismatches += compare_bytes("fusedCompressedRaw", name,
+                                            expected, actual, length);
+                FREE(actual);
+        }
+
+        FREE(expected);
+        Rawppm_free_raster(&raw);
+        Pnm_ppmfree(&image);
+        return mismatches;
+}
+
+/* decoder_tests
+ * Purpose: runs decoder_test on random codeword arrays of every size and
+ *              on the array of edge values
+ * Parameters: n/a
+ * Returns: number of outputs that differ
+ */
+uint64_t decoder_tests()
+{
+        uint64_t mismatches = 0;
+        char name[64];
+
+        for (int s = 0; s < NUM_CODEWORD_SIZES; s++) {
+                int width = codewordSizes[s][0], height = codewordSizes[s][1];
+                snprintf(name, sizeof(name), "random %dx%d", width, height);
+                A2Methods_UArray2 codewords = random_codewords(width, height);
+                mismatches += decoder_test(codewords, name);
+                uarray2_methods_plain->free(&codewords);
+        }
+
+        A2Methods_UArray2 codewords = edge_codewords();
+        mismatches += decoder_test(codewords, "edge values");
+        uarray2_methods_plain->free(&codewords);
+
+        printf("%d codeword arrays on 1 to %d threads\n",
+               NUM_CODEWORD_SIZES + 1, threads[NUM_THREADS - 1]);
+        printf("%lu mismatches with decompressedImage\n", mismatches);
+        return mismatches;
+}
+
+/* decoder_test
+ * Purpose: decodes one codeword array with decompressedImage on one
+ *              thread, then with decompressedImage, fusedDecompressedImage
+ *              and fusedDecompressedRaw on every thread count, and compares
+ *              their pixels with the first
+ * Parameters: UArray2 of codewords, its description
+ * Returns: number of outputs that differ
+ */
+uint64_t decoder_test(A2Methods_UArray2 codewords, const char *name)
+{
+        uint64_t mismatches = 0;
+        int width = uarray2_methods_plain->width(codewords);
+        int height = uarray2_methods_plain->height(codewords);
+        size_t length = (size_t) width * 2 * height * 2 * 3;
+        unsigned char *bytes = codeword_bytes(codewords);
+
+        Parallel_set_threads(1);
+        A2Methods_UArray2 pixels = decompressedImage(codewords);
+        unsigned char *expected = pixel_bytes(pixels);
+        uarray2_methods_plain->free(&pixels);
+
+        for (int t = 0; t < NUM_THREADS; t++) {
+                Parallel_set_threads(threads[t]);
+
+                pixels = decompressedImage(codewords);
+                unsigned char *actual = pixel_bytes(pixels);
+                mismatches += compare_bytes("decompressedImage", name,
+                                            expected, actual, length);
+                FREE(actual);
+                uarray2_methods_plain->free(&pixels);
+
+                pixels = fusedDecompressedImage(codewords);
+                actual = pixel_bytes(pixels);
+                mismatches += compare_bytes("fusedDecompressedImage", name,
+                                            expected, actual, length);
+                FREE(actual);
+                uarray2_methods_plain->free(&pixels);
+
+                actual = poisoned_copy(expected, length);
+                fusedDecompressedRaw(bytes, width, height, actual);
+                mismatches += compare_bytes("fusedDecompressedRaw", name,
+                                            expected, actual, length);
+                FREE(actual);
+        }
+
+        FREE(expected);
+        FREE(bytes);
+        return mismatches;
+}
+
+/* random_codewords
+ * Purpose: makes an array of random codewords (every 32 bit word is a
+ *              valid codeword, see codeword.h)
+ * Parameters: width and height in codewords
+ * Returns: UArray2 of uint32_t, freed with the plain methods
+ */
+A2Methods_UArray2 random_codewords(int width, int height)
+{
+        A2Methods_UArray2 codewords = uarray2_methods_plain->new(width, height,
+                                                        sizeof(uint32_t));
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        *(uint32_t *) uarray2_methods_plain->at(codewords,
+                                                col, row) = random_word();
+                }
+        }
+
+        return codewords;
+}
+
+/* edge_codewords
+ * Purpose: makes an array holding every combination of the edge values of
+ *              the six fields (the lowest and highest two and the two
+ *              around the middle), in row major order; the cells left over
+ *              are random
+ * Parameters: n/a
+ * Returns: UArray2 of EDGE_WIDTH by EDGE_HEIGHT uint32_t, freed with the
+ *              plain methods
+ */
+A2Methods_UArray2 edge_codewords()
+{
+        A2Methods_UArray2 codewords = random_codewords(EDGE_WIDTH,
+                                                       EDGE_HEIGHT);
+        int combinations = 1;
+        for (int field = 0; field < 6; field++) {
+                combinations *= EDGE_VALUES;
+        }
+        assert(combinations <= EDGE_WIDTH * EDGE_HEIGHT);
+
+        for (int i = 0; i < combinations; i++) {
+                int digit[6];
+                int rest = i;
+                for (int field = 0; field < 6; field++) {
+                        digit[field] = rest % EDGE_VALUES;
+                        rest /= EDGE_VALUES;
+                }
+                *(uint32_t *) uarray2_methods_plain->at(codewords,
+                                i % EDGE_WIDTH, i / EDGE_WIDTH) =
+                        Codeword_pack(edgeA[digit[0]], edgeBCD[digit[1]],
+                                      edgeBCD[digit[2]], edgeBCD[digit[3]],
+                                      edgeChroma[digit[4]],
+                                      edgeChroma[digit[5]]);
+        }
+
+        return codewords;
+}
+
+/* random_word
+ * Purpose: returns 32 random bits (rand gives at least 15 at a time)
+ * Parameters: n/a
+ * Returns: the word
+ */
+uint32_t random_word()
+{
+        uint32_t word = 0;
+        for (int i = 0; i < 3; i++) {
+                word = (word << 15) ^ (uint32_t) rand();
+        }
+
+        return word;
+}
+
+/* stream_encoder_tests
+ * Purpose: runs stream_encoder_test on every size and denominator
+ * Parameters: n/a
+ * Returns: number of outputs that differ
+ */
+uint64_t stream_encoder_tests()
+{
+        uint64_t mismatches = 0;
+        int images = 0;
+
+        for (int s = 0; s < NUM_SIZES; s++) {
+                for (int d = 0; d < NUM_DENOMINATORS; d++) {
+                        mismatches += stream_encoder_test(sizes[s][0],
+                                                          sizes[s][1],
+                                                          denominators[d]);
+                        images++;
+                }
+        }
+
+        printf("%d images on 1 to %d threads\n", images,
+               threads[NUM_THREADS - 1]);
+        printf("%lu mismatches with compressedImage\n", mismatches);
+        return mismatches;
+}
+
+/* stream_encoder_test
+ * Purpose: saves a random test image as a raw PPM, compresses the file
+ *              with compress40 and compress40_stream on every thread count
+ *              and compares what they write with the header and
+ *              compressedImage's codewords
+ * Parameters: width, height and denominator of the image
+ * Returns: number of outputs that differ
+ */
+uint64_t stream_encoder_test(int width, int height, unsigned denominator)
+{
+        uint64_t mismatches = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "random %dx%d /%u", width, height,
+                 denominator);
+
+        Pnm_ppm image = test_image(width, height, denominator, "random");
+        FILE *ppm = ppm_file(image);
+
+        Parallel_set_threads(1);
+        A2Methods_UArray2 codewords = compressedImage(image);
+        unsigned char *bytes = codeword_bytes(codewords);
+        size_t codewordLength = (size_t) (width / 2) * (height / 2) * 4;
+        uarray2_methods_plain->free(&codewords);
+
+        char header[64];
+        size_t headerLength = snprintf(header, sizeof(header),
+                                       "COMP40 Compressed image format 2\n"
+                                       "%d %d\n", width / 2, height / 2);
+        size_t length = headerLength + codewordLength;
+        unsigned char *expected = ALLOC(length + 1);
+        memcpy(expected, header, headerLength);
+        memcpy(expected + headerLength, bytes, codewordLength);
+        FREE(bytes);
+
+        for (int t = 0; t < NUM_THREADS; t++) {
+                Parallel_set_threads(threads[t]);
+                size_t actualLength;
+
+                rewind(ppm);
+                unsigned char *actual = captured_output(compress40, ppm,
+                                                        &actualLength);
+                mismatches += compare_output("compress40", name, expected,
+                                             length, actual, actualLength);
+                FREE(actual);
+
+                rewind(ppm);
+                actual = captured_output(compress40_stream, ppm,
+                                         &actualLength);
+                mismatches += compare_output("compress40_stream", name,
+                                             expected, length, actual,
+                                             actualLength);
+                FREE(actual);
+        }
+
+        FREE(expected);
+        fclose(ppm);
+        Pnm_ppmfree(&image);
+        return mismatches;
+}
+
+/* stream_decoder_tests
+ * Purpose: runs stream_decoder_test on random codeword arrays of every
+ *              size and on the array of edge values
+ * Parameters: n/a
+ * Returns: number of outputs that differ
+ */
+uint64_t stream_decoder_tests()
+{
+        uint64_t mismatches = 0;
+        char name[64];
+
+        for (int s = 0; s < NUM_CODEWORD_SIZES; s++) {
+                int width = codewordSizes[s][0], height = codewordSizes[s][1];
+                snprintf(name, sizeof(name), "random %dx%d", width, height);
+                A2Methods_UArray2 codewords = random_codewords(width, height);
+                mismatches += stream_decoder_test(codewords, name);
+                uarray2_methods_plain->free(&codewords);
+        }
+
+        A2Methods_UArray2 codewords = edge_codewords();
+        mismatches += stream_decoder_test(codewords, "edge values");
+        uarray2_methods_plain->free(&codewords);
+
+        printf("%d compressed images on 1 to %d threads\n",
+               NUM_CODEWORD_SIZES + 1, threads[NUM_THREADS - 1]);
+        printf("%lu mismatches with decompressedImage\n", mismatches);
+        return mismatches;
+}
+
+/* stream_decoder_test
+ * Purpose: saves a codeword array as a compressed file, decompresses it
+ *              with decompress40, decompress40_stream and
+ *              decompress40_mapped on every thread count and compares what
+ *              they write with a PPM of decompressedImage's pixels
+ * Parameters: UArray2 of codewords, its description
+ * Returns: number of outputs that differ
+ */
+uint64_t stream_decoder_test(A2Methods_UArray2 codewords, const char *name)
+{
+        static void (*const decoders[3])(FILE *input) = {
+                decompress40, decompress40_stream, decompress40_mapped
+        };
+        static const char *decoderNames[3] = {
+                "decompress40", "decompress40_stream", "decompress40_mapped"
+        };
+        uint64_t mismatches = 0;
+        int width = uarray2_methods_plain->width(codewords) * 2;
+        int height = uarray2_methods_plain->height(codewords) * 2;
+        FILE *compressed = compressed_file(codewords);
+
+        Parallel_set_threads(1);
+        A2Methods_UArray2 pixels = decompressedImage(codewords);
+        unsigned char *raster = pixel_bytes(pixels);
+        size_t rasterLength = (size_t) width * height * 3;
+        uarray2_methods_plain->free(&pixels);
+
+        char header[64];
+        size_t headerLength = snprintf(header, sizeof(header),
+                                       "P6\n%d %d\n255\n", width, height);
+        size_t length = headerLength + rasterLength;
+        unsigned char *expected = ALLOC(length + 1);
+        memcpy(expected, header, headerLength);
+        memcpy(expected + headerLength, raster, rasterLength);
+        FREE(raster);
+
+        for (int t = 0; t < NUM_THREADS; t++) {
+                Parallel_set_threads(threads[t]);
+
+                for (int d = 0; d < 3; d++) {
+                        size_t actualLength;
+                        rewind(compressed);
+                        unsigned char *actual = captured_output(decoders[d],
+                                                compressed, &actualLength);
+                        mismatches += compare_output(decoderNames[d], name,
+                                                     expected, length,
+                                                     actual, actualLength);
+                        FREE(actual);
+                }
+        }
+
+        FREE(expected);
+        fclose(compressed);
+        return mismatches;
+}
+
+/* scale_tests
+ * Purpose: runs scale_test on every pattern at every denominator of scales
+ * Parameters: n/a
+ * Returns: number of images whose error is out of line
+ */
+uint64_t scale_tests()
+{
+        uint64_t failures = 0;
+
+        for (int d = 0; d < NUM_SCALES; d++) {
+                for (int p = 0; p < NUM_PATTERNS; p++) {
+                        failures += scale_test(scales[d], patterns[p]);
+                }
+        }
+
+        printf("%lu errors out of line\n", failures);
+        return failures;
+}
+
+/* scale_test
+ * Purpose: round trips a test image and the same image scaled to
+ *              denominator 255, compares each with the scaled image and
+ *              checks that the two errors agree
+ * Parameters: denominator and pattern of the image
+ * Returns: 1 if the errors do not agree, 0 if they do
+ */
+uint64_t scale_test(unsigned denominator, const char *pattern)
+{
+        int width = sizes[NUM_SIZES - 1][0], height = sizes[NUM_SIZES - 1][1];
+        Parallel_set_threads(threads[NUM_THREADS - 1]);
+
+        Pnm_ppm image = test_image(width, height, denominator, pattern);
+        struct Rawppm raw, reference;
+        Rawppm_from_pnm(image, &raw);
+        Rawppm_rescale(&raw, 255, &reference);
+        Rawppm_free_raster(&raw);
+        Pnm_ppm image255 = Rawppm_to_pnm(&reference, uarray2_methods_plain);
+
+        struct Imagediff diff, diff255;
+        roundtrip_difference(image, &reference, &diff);
+        roundtrip_difference(image255, &reference, &diff255);
+        double rmse = Imagediff_rmse(&diff, IMAGEDIFF_ALL);
+        double rmse255 = Imagediff_rmse(&diff255, IMAGEDIFF_ALL);
+
+        printf("%s %dx%d /%u: rmse %.4f, psnr %.2f dB, max error %u "
+               "(/255: rmse %.4f, max error %u)\n", pattern, width, height,
+               denominator, rmse, Imagediff_psnr(&diff, IMAGEDIFF_ALL, 255),
+               Imagediff_max_error(&diff, IMAGEDIFF_ALL), rmse255,
+               Imagediff_max_error(&diff255, IMAGEDIFF_ALL));
+
+        Pnm_ppmfree(&image255);
+        Rawppm_free_raster(&reference);
+        Pnm_ppmfree(&image);
+        return (rmse - rmse255 > RMSE_TOLERANCE ||
+                rmse255 - rmse > RMSE_TOLERANCE) ? 1 : 0;
+}
+
+/* roundtrip_difference
+ * Purpose: compresses and decompresses an image in memory and compares
+ *              the pixels, which have denominator 255, with a reference
+ * Parameters: image, reference raster with denominator 255, totals to
+ *              fill in
+ * Returns: N/A
+ */
+void roundtrip_difference(Pnm_ppm image, Rawppm reference, Imagediff diff)
+{
+        A2Methods_UArray2 codewords = compressedImage(image);
+        A2Methods_UArray2 pixels = decompressedImage(codewords);
+        struct Pnm_ppm output = {
+                .width = uarray2_methods_plain->width(pixels),
+                .height = uarray2_methods_plain->height(pixels),
+                .denominator = 255, .pixels = pixels,
+                .methods = uarray2_methods_plain };
+        struct Rawppm decompressed;
+        Rawppm_from_pnm(&output, &decompressed);
+
+        Imagediff_clear(diff);
+        Imagediff_add(diff, reference, &decompressed, decompressed.width,
+                      decompressed.height);
+
+        Rawppm_free_raster(&decompressed);
+        uarray2_methods_plain->free(&pixels);
+        uarray2_methods_plain->free(&codewords);
+}
+
+/* ppm_file
+ * Purpose: saves an image as a raw PPM with its own denominator (2 big
+ *              endian bytes per sample above 255) in a temporary file
+ * Parameters: the image
+ * Returns: the file, positioned at its start; it is deleted when closed
+ */
+FILE *ppm_file(Pnm_ppm image)
+{
+        FILE *fp = tmpfile();
+        assert(fp != NULL);
+
+        struct Rawppm raw;
+        Rawppm_from_pnm(image, &raw);
+        int written = fprintf(fp, "P6\n%u %u\n%u\n", raw.width, raw.height,
+                              raw.denominator);
+        assert(written > 0);
+        size_t size = raw.rowBytes * raw.height;
+        size_t samples = fwrite(raw.raster, 1, size, fp);
+        assert(samples == size);
+        Rawppm_free_raster(&raw);
+
+        rewind(fp);
+        return fp;
+}
+
+/* compressed_file
+ * Purpose: saves a codeword array in the compressed format in a temporary
+ *              file
+ * Parameters: UArray2 of uint32_t codewords
+ * Returns: the file, positioned at its start; it is deleted when closed
+ */
+FILE *compressed_file(A2Methods_UArray2 codewords)
+{
+        FILE *fp = tmpfile();
+        assert(fp != NULL);
+
+        int width = uarray2_methods_plain->width(codewords);
+        int height = uarray2_methods_plain->height(codewords);
+        int written = fprintf(fp, "COMP40 Compressed image format 2\n"
+                              "%d %d\n", width, height);
+        assert(written > 0);
+        size_t size = (size_t) width * height * 4;
+        unsigned char *bytes = codeword_bytes(codewords);
+        size_t words = fwrite(bytes, 1, size, fp);
+        assert(words == size);
+        FREE(bytes);
+
+        rewind(fp);
+        return fp;
+}
+
+/* captured_output
+ * Purpose: runs one of the programs' entry points, which write to
+ *              standard output, with standard output sent to a temporary
+ *              file, and reads back what it wrote
+ * Parameters: entry point, file to give it, where to store the number of
+ *              bytes written
+ * Returns: the bytes written, freed with FREE
+ */
+unsigned char *captured_output(void (*run)(FILE *input), FILE *input,
+                               size_t *length)
+{
+        FILE *capture = tmpfile();
+        assert(capture != NULL);
+
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        assert(saved >= 0);
+        int redirected = dup2(fileno(capture), STDOUT_FILENO);
+        assert(redirected >= 0);
+
+        run(input);
+
+        fflush(stdout);
+        int restored = dup2(saved, STDOUT_FILENO);
+        assert(restored >= 0);
+        close(saved);
+
+        struct stat info;
+        int status = fstat(fileno(capture), &info);
+        assert(status == 0);
+        *length = info.st_size;
+        unsigned char *bytes = ALLOC(*length + 1);
+        rewind(capture);
+        size_t read = fread(bytes, 1, *length, capture);
+        assert(read == *length);
+        fclose(capture);
+
+        return bytes;
+}
+
+/* compare_output
+ * Purpose: compares a captured output with the expected one, length first
+ * Parameters: entry point that wrote the output, image description,
+ *              expected bytes and their number, actual bytes and their
+ *              number
+ * Returns: 1 if they differ, 0 if not
+ */
+uint64_t compare_output(const char *what, const char *image,
+                        const unsigned char *expected, size_t expectedLength,
+                        const unsigned char *actual, size_t actualLength)
+{
+        if (actualLength != expectedLength) {
+                printf("%s (%s, %d threads): wrote %zu bytes, expected "
+                       "%zu\n", what, image, Parallel_threads(),
+                       actualLength, expectedLength);
+                return 1;
+        }
+
+        return compare_bytes(what, image, expected, actual, expectedLength);
+}
+
+/* test_image
+ * Purpose: makes a test image: random samples, a smooth ramp in each
+ *              channel, or only 0 and the denominator in a checkerboard of
+ *              colors
+ * Parameters: width, height, denominator, pattern ("random", "smooth" or
+ *              "extreme")
+ * Returns: the image, freed with Pnm_ppmfree
+ */
+Pnm_ppm test_image(int width, int height, unsigned denominator,
+                   const char *pattern)
+{
+        Pnm_ppm image;
+        NEW(image);
+        image->width = width;
+        image->height = height;
+        image->denominator = denominator;
+        image->methods = uarray2_methods_plain;
+        image->pixels = uarray2_methods_plain->new(width, height,
+                                                   sizeof(struct Pnm_rgb));
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        Pnm_rgb pixel = uarray2_methods_plain->at(
+                                                image->pixels, col, row);
+                        unsigned rgb[3];
+                        for (int c = 0; c < 3; c++) {
+                                if (pattern[0] == 'r') {
+                                        rgb[c] = (unsigned) rand() %
+                                                 (denominator + 1);
+                                } else if (pattern[0] == 's') {
+                                        uint64_t step = (uint64_t) (col +
+                                                (c + 1) * row) * denominator;
+                                        rgb[c] = step / (width + 3 * height);
+                                } else {
+                                        rgb[c] = ((col + row + c) % 2) *
+                                                 denominator;
+                                }
+                        }
+                        pixel->red = rgb[0];
+                        pixel->green = rgb[1];
+                        pixel->blue = rgb[2];
+                }
+        }
+
+        return image;
+}
+
+/* codeword_bytes
+ * Purpose: lays the codewords out as the compressed format stores them:
+ *              row major, 4 big endian bytes each
+ * Parameters: UArray2 of uint32_t codewords
+ * Returns: the bytes, freed with FREE
+ */
+unsigned char *codeword_bytes(A2Methods_UArray2 codewords)
+{
+        int width = uarray2_methods_plain->width(codewords);
+        int height = uarray2_methods_plain->height(codewords);
+        unsigned char *bytes = ALLOC((size_t) width * height * 4 + 1);
+        unsigned char *byte = bytes;
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        uint32_t word = *(uint32_t *) uarray2_methods_plain->
+                                                at(codewords, col, row);
+                        *byte++ = word >> 24;
+                        *byte++ = (word >> 16) & 0xff;
+                        *byte++ = (word >> 8) & 0xff;
+                        *byte++ = word & 0xff;
+                }
+        }
+
+        return bytes;
+}
+
+/* pixel_bytes
+ * Purpose: lays decoded pixels out as a raw PPM raster with denominator
+ *              255: row major, red, green and blue bytes
+ * Parameters: UArray2 of Pnm_rgb
+ * Returns: the bytes, freed with FREE
+ */
+unsigned char *pixel_bytes(A2Methods_UArray2 pixels)
+{
+        int width = uarray2_methods_plain->width(pixels);
+        int height = uarray2_methods_plain->height(pixels);
+        unsigned char *bytes = ALLOC((size_t) width * height * 3 + 1);
+        unsigned char *byte = bytes;
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        Pnm_rgb pixel = uarray2_methods_plain->at(pixels,
+                                                                  col, row);
+                        *byte++ = pixel->red;
+                        *byte++ = pixel->green;
+                        *byte++ = pixel->blue;
+                }
+        }
+
+        return bytes;
+}
+
+/* poisoned_copy
+ * Purpose: allocates an output buffer in which every byte differs from
+ *              the expected output, so that a byte an engine forgets to
+ *              write can not match by chance
+ * Parameters: expected bytes, number of bytes
+ * Returns: the buffer, freed with FREE
+ */
+unsigned char *poisoned_copy(const unsigned char *expected, size_t n)
+{
+        unsigned char *bytes = ALLOC(n + 1);
+        for (size_t i = 0; i < n; i++) {
+                bytes[i] = ~expected[i];
+        }
+
+        return bytes;
+}
+
+/* compare_bytes
+ * Purpose: compares one output with the expected one, prints the first
+ *              few that differ and where they first differ
+ * Parameters: engine that made the output, image description, expected
+ *              and actual bytes, number of bytes
+ * Returns: 1 if they differ, 0 if not
+ */
+uint64_t compare_bytes(const char *what, const char *image,
+                       const unsigned char *expected,
+                       const unsigned char *actual, size_t n)
+{
+        static uint64_t printed = 0;
+
+        if (n == 0 || memcmp(expected, actual, n) == 0) {
+                return 0;
+        }
+        if (printed++ < 10) {
+                size_t i = 0;
+                while (expected[i] == actual[i]) {
+                        i++;
+                }
+                printf("%s (%s, %d threads): byte %zu is %u, expected %u\n",
+                       what, image, Parallel_threads(), i, actual[i],
+                       expected[i]);
+        }
+
+        return 1;
+}
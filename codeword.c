@@ -0,0 +1,463 @@
+/*
+ *     codeword.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the bulk codeword functions
+ *      whose declarations are included in codeword.h: packing and unpacking
+ *      a whole batch of quantized blocks at once, optionally writing or 
+ *      reading the big endian bytes of the compressed format in the same 
+ *      pass, and converting whole rows between codewords and big endian 
+ *      bytes.
+ *
+ *     The SSE2 and AVX2 kernels do the shifts and masks of Codeword_pack 
+ *      and the Codeword_* getters on 4 or 8 codewords at a time, so every
+ *      kernel gives exactly the same codewords.
+ *     
+ */ 
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "dct.h"
+#include "codeword.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* the kernels store big endian bytes instead of codewords when swap is 1 */
+typedef void pack_fun(const struct DCT_quant_batch *quant, int n, 
+                      void *dest, int swap);
+typedef void unpack_fun(const void *src, int n, 
+                        struct DCT_quant_batch *quant, int swap);
+typedef void swap_fun(const void *src, int n, void *dest);
+
+static pack_fun pack_scalar;
+static unpack_fun unpack_scalar;
+static swap_fun swap_scalar;
+
+static pack_fun *pack = pack_scalar;
+static unpack_fun *unpack = unpack_scalar;
+static swap_fun *swap = swap_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernels(void);
+
+/* ======================================================================
+                        PUBLIC ENTRY POINTS        
+   ====================================================================== */
+
+/* Codeword_pack_batch
+ * Purpose: packs n quantized blocks into codewords, see Codeword_pack
+ * Parameters: quantized blocks, count, destination codewords
+ * Returns: N/A
+ */
+void Codeword_pack_batch(const struct DCT_quant_batch *quant, int n, 
+                         uint32_t *codewords)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&kernel_once, choose_kernels);
+        pack(quant, n, codewords, 0);
+}
+
+/* Codeword_pack_batch_be
+ * Purpose: packs n quantized blocks and stores the codewords as big endian
+ *              bytes, ready to be written out
+ * Parameters: quantized blocks, count, destination (4 * n bytes)
+ * Returns: N/A
+ */
+void Codeword_pack_batch_be(const struct DCT_quant_batch *quant, int n, 
+                            unsigned char *bytes)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&kernel_once, choose_kernels);
+        pack(quant, n, bytes, 1);
+}
+
+/* Codeword_unpack_batch
+ * Purpose: unpacks n codewords into quantized blocks, see the Codeword_* 
+ *              getters
+ * Parameters: codewords, count, destination quantized blocks
+ * Returns: N/A
+ */
+void Codeword_unpack_batch(const uint32_t *codewords, int n, 
+                           struct DCT_quant_batch *quant)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&kernel_once, choose_kernels);
+        unpack(codewords, n, quant, 0);
+}
+
+/* Codeword_unpack_batch_be
+ * Purpose: unpacks n codewords stored as big endian bytes
+ * Parameters: source (4 * n bytes), count, destination quantized blocks
+ * Returns: N/A
+ */
+void Codeword_unpack_batch_be(const unsigned char *bytes, int n, 
+                              struct DCT_quant_batch *quant)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&kernel_once, choose_kernels);
+        unpack(bytes, n, quant, 1);
+}
+
+/* Codeword_to_bigendian
+ * Purpose: stores n codewords as big endian bytes
+ * Parameters: codewords, count, destination (4 * n bytes, may be the same 
+ *              memory as the codewords to swap them in place)
+ * Returns: N/A
+ */
+void Codeword_to_bigendian(const uint32_t *codewords, long n, 
+                           unsigned char *bytes)
+{
+        assert(n >= 0);
+        pthread_once(&kernel_once, choose_kernels);
+        for (long start = 0; start < n; start += ROW_CHUNK) {
+                int count = (n - start < ROW_CHUNK) ? n - start : ROW_CHUNK;
+                swap(&codewords[start], count, &bytes[start * 4]);
+        }
+}
+
+/* Codeword_from_bigendian
+ * Purpose: loads n codewords stored as big endian bytes
+ * Parameters: source (4 * n bytes), count, destination codewords (may be 
+ *              the same memory as the source to swap them in place)
+ * Returns: N/A
+ */
+void Codeword_from_bigendian(const unsigned char *bytes, long n, 
+                             uint32_t *codewords)
+{
+        assert(n >= 0);
+        pthread_once(&kernel_once, choose_kernels);
+        for (long start = 0; start < n; start += ROW_CHUNK) {
+                int count = (n - start < ROW_CHUNK) ? n - start : ROW_CHUNK;
+                swap(&bytes[start * 4], count, &codewords[start]);
+        }
+}
+
+/* Codeword_kernel
+ * Purpose: reports which kernel was picked for this CPU
+ * Parameters: N/A
+ * Returns: "avx2", "sse2" or "scalar"
+ */
+const char *Codeword_kernel(void)
+{
+        pthread_once(&kernel_once, choose_kernels);
+        return kernel_name;
+}
+
+/* ======================================================================
+                        SCALAR KERNELS        
+   ====================================================================== */
+
+static inline uint32_t byteswap(uint32_t word)
+{
+        return __builtin_bswap32(word);
+}
+
+static inline uint32_t load_word(const void *src, int k, int swap)
+{
+        uint32_t word;
+        memcpy(&word, (const unsigned char *) src + 4 * k, sizeof(word));
+        return swap ? byteswap(word) : word;
+}
+
+static inline void store_word(void *dest, int k, uint32_t word, int swap)
+{
+        word = swap ? byteswap(word) : word;
+        memcpy((unsigned char *) dest + 4 * k, &word, sizeof(word));
+}
+
+static void pack_scalar_from(const struct DCT_quant_batch *quant, int n, 
+                             void *dest, int swap, int start)
+{
+        for (int k = start; k < n; k++) {
+                store_word(dest, k, Codeword_pack(quant->a[k], quant->b[k], 
+                                        quant->c[k], quant->d[k], 
+                                        quant->pb[k], quant->pr[k]), swap);
+        }
+}
+
+static void unpack_scalar_from(const void *src, int n, 
+                               struct DCT_quant_batch *quant, int swap, 
+                               int start)
+{
+        for (int k = start; k < n; k++) {
+                uint32_t word = load_word(src, k, swap);
+                quant->a[k] = Codeword_a(word);
+                quant->b[k] = Codeword_b(word);
+                quant->c[k] = Codeword_c(word);
+                quant->d[k] = Codeword_d(word);
+                quant->pb[k] = Codeword_pb(word);
+                quant->pr[k] = Codeword_pr(word);
+        }
+}
+
+static void swap_scalar_from(const void *src, int n, void *dest, int start)
+{
+        for (int k = start; k < n; k++) {
+                store_word(dest, k, load_word(src, k, 1), 0);
+        }
+}
+
+static void pack_scalar(const struct DCT_quant_batch *quant, int n, 
+                        void *dest, int swap)
+{
+        pack_scalar_from(quant, n, dest, swap, 0);
+}
+
+static void unpack_scalar(const void *src, int n, 
+                          struct DCT_quant_batch *quant, int swap)
+{
+        unpack_scalar_from(src, n, quant, swap, 0);
+}
+
+static void swap_scalar(const void *src, int n, void *dest)
+{
+        swap_scalar_from(src, n, dest, 0);
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* ======================================================================
+                        SSE2 KERNELS (4 codewords at a time)
+   ====================================================================== */
+
+/* byteswap_sse2
+ * Purpose: swaps the two halves of each codeword, then the two bytes of 
+ *              each half (SSE2 has no byte shuffle)
+ */
+__attribute__((target("sse2")))
+static inline __m128i byteswap_sse2(__m128i x)
+{
+        x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+        return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+/* gets_sse2
+ * Purpose: signed field of each codeword: shift it to the top, then 
+ *              arithmetic shift it back down
+ */
+__attribute__((target("sse2")))
+static inline __m128i gets_sse2(__m128i word, int width, int lsb)
+{
+        return _mm_srai_epi32(_mm_slli_epi32(word, 
+                                        CODEWORD_BITS - width - lsb), 
+                              CODEWORD_BITS - width);
+}
+
+__attribute__((target("sse2")))
+static void pack_sse2(const struct DCT_quant_batch *quant, int n, 
+                      void *dest, int swap)
+{
+        const __m128i six = _mm_set1_epi32(0x3f);
+        const __m128i four = _mm_set1_epi32(0xf);
+        unsigned char *bytes = dest;
+        int k = 0;
+
+        for (; k + 4 <= n; k += 4) {
+                __m128i a = _mm_loadu_si128((const __m128i *) &quant->a[k]);
+                __m128i b = _mm_loadu_si128((const __m128i *) &quant->b[k]);
+                __m128i c = _mm_loadu_si128((const __m128i *) &quant->c[k]);
+                __m128i d = _mm_loadu_si128((const __m128i *) &quant->d[k]);
+                __m128i pb = _mm_loadu_si128((const __m128i *) &quant->pb[k]);
+                __m128i pr = _mm_loadu_si128((const __m128i *) &quant->pr[k]);
+
+                __m128i word = _mm_slli_epi32(a, CODEWORD_A_LSB);
+                word = _mm_or_si128(word, _mm_slli_epi32(
+                        _mm_and_si128(b, six), CODEWORD_B_LSB));
+                word = _mm_or_si128(word, _mm_slli_epi32(
+                        _mm_and_si128(c, six), CODEWORD_C_LSB));
+                word = _mm_or_si128(word, _mm_slli_epi32(
+                        _mm_and_si128(d, six), CODEWORD_D_LSB));
+                word = _mm_or_si128(word, _mm_slli_epi32(
+                        _mm_and_si128(pb, four), CODEWORD_PB_LSB));
+                word = _mm_or_si128(word, _mm_and_si128(pr, four));
+
+                if (swap) {
+                        word = byteswap_sse2(word);
+                }
+                _mm_storeu_si128((__m128i *) &bytes[4 * k], word);
+        }
+        pack_scalar_from(quant, n, dest, swap, k);
+}
+
+__attribute__((target("sse2")))
+static void unpack_sse2(const void *src, int n, 
+                        struct DCT_quant_batch *quant, int swap)
+{
+        const __m128i four = _mm_set1_epi32(0xf);
+        const unsigned char *bytes = src;
+        int k = 0;
+
+        for (; k + 4 <= n; k += 4) {
+                __m128i word = _mm_loadu_si128((const __m128i *) &bytes[4 * k]);
+                if (swap) {
+                        word = byteswap_sse2(word);
+                }
+
+                _mm_storeu_si128((__m128i *) &quant->a[k], 
+                                 _mm_srli_epi32(word, CODEWORD_A_LSB));
+                _mm_storeu_si128((__m128i *) &quant->b[k], gets_sse2(word, 
+                                CODEWORD_B_WIDTH, CODEWORD_B_LSB));
+                _mm_storeu_si128((__m128i *) &quant->c[k], gets_sse2(word, 
+                                CODEWORD_C_WIDTH, CODEWORD_C_LSB));
+                _mm_storeu_si128((__m128i *) &quant->d[k], gets_sse2(word, 
+                                CODEWORD_D_WIDTH, CODEWORD_D_LSB));
+                _mm_storeu_si128((__m128i *) &quant->pb[k], _mm_and_si128(
+                        _mm_srli_epi32(word, CODEWORD_PB_LSB), four));
+                _mm_storeu_si128((__m128i *) &quant->pr[k], 
+                                 _mm_and_si128(word, four));
+        }
+        unpack_scalar_from(src, n, quant, swap, k);
+}
+
+__attribute__((target("sse2")))
+static void swap_sse2(const void *src, int n, void *dest)
+{
+        const unsigned char *in = src;
+        unsigned char *out = dest;
+        int k = 0;
+
+        for (; k + 4 <= n; k += 4) {
+                __m128i word = _mm_loadu_si128((const __m128i *) &in[4 * k]);
+                _mm_storeu_si128((__m128i *) &out[4 * k], 
+                                 byteswap_sse2(word));
+        }
+        swap_scalar_from(src, n, dest, k);
+}
+
+/* ======================================================================
+                        AVX2 KERNELS (8 codewords at a time)
+   ====================================================================== */
+
+__attribute__((target("avx2")))
+static inline __m256i byteswap_avx2(__m256i x)
+{
+        const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 
+                                               11, 10, 9, 8, 15, 14, 13, 12,
+                                               3, 2, 1, 0, 7, 6, 5, 4, 
+                                               11, 10, 9, 8, 15, 14, 13, 12);
+        return _mm256_shuffle_epi8(x, order);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gets_avx2(__m256i word, int width, int lsb)
+{
+        return _mm256_srai_epi32(_mm256_slli_epi32(word, 
+                                        CODEWORD_BITS - width - lsb), 
+                                 CODEWORD_BITS - width);
+}
+
+__attribute__((target("avx2")))
+static void pack_avx2(const struct DCT_quant_batch *quant, int n, 
+                      void *dest, int swap)
+{
+        const __m256i six = _mm256_set1_epi32(0x3f);
+        const __m256i four = _mm256_set1_epi32(0xf);
+        unsigned char *bytes = dest;
+        int k = 0;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256i a = _mm256_loadu_si256((const __m256i *) &quant->a[k]);
+                __m256i b = _mm256_loadu_si256((const __m256i *) &quant->b[k]);
+                __m256i c = _mm256_loadu_si256((const __m256i *) &quant->c[k]);
+                __m256i d = _mm256_loadu_si256((const __m256i *) &quant->d[k]);
+                __m256i pb = _mm256_loadu_si256(
+                                        (const __m256i *) &quant->pb[k]);
+                __m256i pr = _mm256_loadu_si256(
+                                        (const __m256i *) &quant->pr[k]);
+
+                __m256i word = _mm256_slli_epi32(a, CODEWORD_A_LSB);
+                word = _mm256_or_si256(word, _mm256_slli_epi32(
+                        _mm256_and_si256(b, six), CODEWORD_B_LSB));
+                word = _mm256_or_si256(word, _mm256_slli_epi32(
+                        _mm256_and_si256(c, six), CODEWORD_C_LSB));
+                word = _mm256_or_si256(word, _mm256_slli_epi32(
+                        _mm256_and_si256(d, six), CODEWORD_D_LSB));
+                word = _mm256_or_si256(word, _mm256_slli_epi32(
+                        _mm256_and_si256(pb, four), CODEWORD_PB_LSB));
+                word = _mm256_or_si256(word, _mm256_and_si256(pr, four));
+
+                if (swap) {
+                        word = byteswap_avx2(word);
+                }
+                _mm256_storeu_si256((__m256i *) &bytes[4 * k], word);
+        }
+        pack_scalar_from(quant, n, dest, swap, k);
+}
+
+__attribute__((target("avx2")))
+static void unpack_avx2(const void *src, int n, 
+                        struct DCT_quant_batch *quant, int swap)
+{
+        const __m256i four = _mm256_set1_epi32(0xf);
+        const unsigned char *bytes = src;
+        int k = 0;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256i word = _mm256_loadu_si256(
+                                        (const __m256i *) &bytes[4 * k]);
+                if (swap) {
+                        word = byteswap_avx2(word);
+                }
+
+                _mm256_storeu_si256((__m256i *) &quant->a[k], 
+                                    _mm256_srli_epi32(word, CODEWORD_A_LSB));
+                _mm256_storeu_si256((__m256i *) &quant->b[k], gets_avx2(word, 
+                                CODEWORD_B_WIDTH, CODEWORD_B_LSB));
+                _mm256_storeu_si256((__m256i *) &quant->c[k], gets_avx2(word, 
+                                CODEWORD_C_WIDTH, CODEWORD_C_LSB));
+                _mm256_storeu_si256((__m256i *) &quant->d[k], gets_avx2(word, 
+                                CODEWORD_D_WIDTH, CODEWORD_D_LSB));
+                _mm256_storeu_si256((__m256i *) &quant->pb[k], 
+                        _mm256_and_si256(_mm256_srli_epi32(word, 
+                                        CODEWORD_PB_LSB), four));
+                _mm256_storeu_si256((__m256i *) &quant->pr[k], 
+                                    _mm256_and_si256(word, four));
+        }
+        unpack_scalar_from(src, n, quant, swap, k);
+}
+
+__attribute__((target("avx2")))
+static void swap_avx2(const void *src, int n, void *dest)
+{
+        const unsigned char *in = src;
+        unsigned char *out = dest;
+        int k = 0;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256i word = _mm256_loadu_si256(
+                                        (const __m256i *) &in[4 * k]);
+                _mm256_storeu_si256((__m256i *) &out[4 * k], 
+                                    byteswap_avx2(word));
+        }
+        swap_scalar_from(src, n, dest, k);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* choose_kernels
+ * Purpose: picks the widest kernels this CPU supports, run once
+ */
+static void choose_kernels(void)
+{
+#ifdef HAVE_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                pack = pack_avx2;
+                unpack = unpack_avx2;
+                swap = swap_avx2;
+                kernel_name = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+                pack = pack_sse2;
+                unpack = unpack_sse2;
+                swap = swap_sse2;
+                kernel_name = "sse2";
+        }
+#endif
+}
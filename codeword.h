@@ -0,0 +1,141 @@
+/*
+ *     codeword.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the layout of a compressed 32 bit codeword and 
+ *      static inline functions that pack and unpack a whole codeword with
+ *      the unchecked getters and setters in fastbitpack.h. 
+ *
+ *     Field   width   lsb     kind
+ *     a       6       26      unsigned
+ *     b       6       20      signed
+ *     c       6       14      signed
+ *     d       6       8       signed
+ *     pb      4       4       unsigned
+ *     pr      4       0       unsigned
+ *
+ *     Every codeword the quantizers produce fits this layout, and since the
+ *      fields cover all 32 bits, every 32 bit word unpacks to valid fields.
+ *
+ *     The bulk functions at the bottom (codeword.c) pack and unpack a whole
+ *      batch of blocks at a time with SIMD shifts and masks, and convert
+ *      to and from the big endian bytes of the compressed format, in the 
+ *      same pass when packing or unpacking.
+ *     
+ */ 
+
+#ifndef CODEWORD_H
+#define CODEWORD_H
+
+#include <stdint.h>
+#include "fastbitpack.h"
+
+#define CODEWORD_BITS 32
+
+#define CODEWORD_A_WIDTH 6
+#define CODEWORD_A_LSB 26
+#define CODEWORD_B_WIDTH 6
+#define CODEWORD_B_LSB 20
+#define CODEWORD_C_WIDTH 6
+#define CODEWORD_C_LSB 14
+#define CODEWORD_D_WIDTH 6
+#define CODEWORD_D_LSB 8
+#define CODEWORD_PB_WIDTH 4
+#define CODEWORD_PB_LSB 4
+#define CODEWORD_PR_WIDTH 4
+#define CODEWORD_PR_LSB 0
+
+/* compile time checks: the fields sit next to each other, from pr at bit 0
+ * up to a at the top of the codeword (an array of size -1 will not compile)
+ */
+typedef char codeword_pr_at_bottom[(CODEWORD_PR_LSB == 0) ? 1 : -1];
+typedef char codeword_pb_after_pr[(CODEWORD_PB_LSB == 
+                        CODEWORD_PR_LSB + CODEWORD_PR_WIDTH) ? 1 : -1];
+typedef char codeword_d_after_pb[(CODEWORD_D_LSB == 
+                        CODEWORD_PB_LSB + CODEWORD_PB_WIDTH) ? 1 : -1];
+typedef char codeword_c_after_d[(CODEWORD_C_LSB == 
+                        CODEWORD_D_LSB + CODEWORD_D_WIDTH) ? 1 : -1];
+typedef char codeword_b_after_c[(CODEWORD_B_LSB == 
+                        CODEWORD_C_LSB + CODEWORD_C_WIDTH) ? 1 : -1];
+typedef char codeword_a_after_b[(CODEWORD_A_LSB == 
+                        CODEWORD_B_LSB + CODEWORD_B_WIDTH) ? 1 : -1];
+typedef char codeword_a_at_top[(CODEWORD_A_LSB + CODEWORD_A_WIDTH == 
+                        CODEWORD_BITS) ? 1 : -1];
+
+/* Codeword_pack
+ * Purpose: packs the quantized values of one block into a codeword
+ * Parameters: a, b, c, d, pb and pr, each already in range for its field
+ * Returns: the codeword
+ */
+static inline uint32_t Codeword_pack(unsigned a, int b, int c, int d, 
+                                     unsigned pb, unsigned pr)
+{
+        uint64_t word = 0;
+        word = Bitpack_newu_fast(word, CODEWORD_A_WIDTH, CODEWORD_A_LSB, a);
+        word = Bitpack_news_fast(word, CODEWORD_B_WIDTH, CODEWORD_B_LSB, b);
+        word = Bitpack_news_fast(word, CODEWORD_C_WIDTH, CODEWORD_C_LSB, c);
+        word = Bitpack_news_fast(word, CODEWORD_D_WIDTH, CODEWORD_D_LSB, d);
+        word = Bitpack_newu_fast(word, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB, 
+                                 pb);
+        word = Bitpack_newu_fast(word, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB, 
+                                 pr);
+
+        return (uint32_t) word;
+}
+
+/* Codeword_a, Codeword_b, ... Codeword_pr
+ * Purpose: unpack one field of a codeword
+ */
+static inline unsigned Codeword_a(uint32_t word)
+{
+        return Bitpack_getu_fast(word, CODEWORD_A_WIDTH, CODEWORD_A_LSB);
+}
+
+static inline int Codeword_b(uint32_t word)
+{
+        return Bitpack_gets_fast(word, CODEWORD_B_WIDTH, CODEWORD_B_LSB);
+}
+
+static inline int Codeword_c(uint32_t word)
+{
+        return Bitpack_gets_fast(word, CODEWORD_C_WIDTH, CODEWORD_C_LSB);
+}
+
+static inline int Codeword_d(uint32_t word)
+{
+        return Bitpack_gets_fast(word, CODEWORD_D_WIDTH, CODEWORD_D_LSB);
+}
+
+static inline unsigned Codeword_pb(uint32_t word)
+{
+        return Bitpack_getu_fast(word, CODEWORD_PB_WIDTH, CODEWORD_PB_LSB);
+}
+
+static inline unsigned Codeword_pr(uint32_t word)
+{
+        return Bitpack_getu_fast(word, CODEWORD_PR_WIDTH, CODEWORD_PR_LSB);
+}
+
+/* bulk versions, up to ROW_CHUNK blocks in struct-of-arrays form */
+struct DCT_quant_batch;
+
+void Codeword_pack_batch(const struct DCT_quant_batch *quant, int n, 
+                         uint32_t *codewords);
+void Codeword_pack_batch_be(const struct DCT_quant_batch *quant, int n, 
+                            unsigned char *bytes);
+void Codeword_unpack_batch(const uint32_t *codewords, int n, 
+                           struct DCT_quant_batch *quant);
+void Codeword_unpack_batch_be(const unsigned char *bytes, int n, 
+                              struct DCT_quant_batch *quant);
+
+/* any number of codewords, 4 bytes each */
+void Codeword_to_bigendian(const uint32_t *codewords, long n, 
+                           unsigned char *bytes);
+void Codeword_from_bigendian(const unsigned char *bytes, long n, 
+                             uint32_t *codewords);
+
+/* name of the kernel in use: "avx2", "sse2" or "scalar" */
+const char *Codeword_kernel(void);
+
+#endif
@@ -0,0 +1,398 @@
+/*
+ *     colorspace.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the color conversion row 
+ *      kernels whose declarations are included in colorspace.h. 
+ *
+ *     The scalar kernels use the exact expressions of RGB_to_compVid and 
+ *      compVid_to_RGBFloat: float inputs, double arithmetic, rounded to 
+ *      float. The SIMD kernels do the same operations, in the same order,
+ *      on packed doubles (no fused multiply-add), so all three kernels 
+ *      give bit for bit the same results and the codec output does not 
+ *      depend on the CPU it runs on.
+ *     
+ */ 
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "colorspace.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+typedef void rgb_to_ypbpr_fun(const float *r, const float *g, const float *b,
+                              float *y, float *pb, float *pr, int n);
+typedef void ypbpr_to_rgb_fun(const float *y, const float *pb, const float *pr,
+                              float *r, float *g, float *b, int n);
+
+static rgb_to_ypbpr_fun rgb_to_ypbpr_scalar;
+static ypbpr_to_rgb_fun ypbpr_to_rgb_scalar;
+
+static rgb_to_ypbpr_fun *rgb_to_ypbpr = rgb_to_ypbpr_scalar;
+static ypbpr_to_rgb_fun *ypbpr_to_rgb = ypbpr_to_rgb_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernels(void);
+static bool set_kernels(const char *name);
+
+/* ======================================================================
+                        PUBLIC ENTRY POINTS        
+   ====================================================================== */
+
+/* Colorspace_rgb_to_ypbpr
+ * Purpose: converts n RGB float pixels to component video
+ * Parameters: planar source channels, planar destination channels, count
+ * Returns: N/A
+ */
+void Colorspace_rgb_to_ypbpr(const float *r, const float *g, const float *b,
+                             float *y, float *pb, float *pr, int n)
+{
+        pthread_once(&kernel_once, choose_kernels);
+        rgb_to_ypbpr(r, g, b, y, pb, pr, n);
+}
+
+/* Colorspace_ypbpr_to_rgb
+ * Purpose: converts n component video pixels to RGB floats
+ * Parameters: planar source channels, planar destination channels, count
+ * Returns: N/A
+ */
+void Colorspace_ypbpr_to_rgb(const float *y, const float *pb, const float *pr,
+                             float *r, float *g, float *b, int n)
+{
+        pthread_once(&kernel_once, choose_kernels);
+        ypbpr_to_rgb(y, pb, pr, r, g, b, n);
+}
+
+/* Colorspace_kernel
+ * Purpose: reports which kernel was picked for this CPU
+ * Parameters: N/A
+ * Returns: "avx2", "sse2" or "scalar"
+ */
+const char *Colorspace_kernel(void)
+{
+        pthread_once(&kernel_once, choose_kernels);
+        return kernel_name;
+}
+
+/* Colorspace_use_kernel
+ * Purpose: switches to the given kernel, so the tests can run every one;
+ *              not to be called while other threads convert pixels
+ * Parameters: "avx2", "sse2" or "scalar"
+ * Returns: false (and the kernel in use is kept) if this CPU can not run it
+ */
+bool Colorspace_use_kernel(const char *name)
+{
+        assert(name != NULL);
+        pthread_once(&kernel_once, choose_kernels);
+        return set_kernels(name);
+}
+
+/* ======================================================================
+                        SCALAR KERNELS        
+   ====================================================================== */
+
+/* rgb_to_ypbpr_scalar
+ * Purpose: one pixel at a time, same expressions as RGB_to_compVid
+ */
+static void rgb_to_ypbpr_scalar(const float *r, const float *g, 
+                                const float *b, float *y, float *pb, 
+                                float *pr, int n)
+{
+        for (int i = 0; i < n; i++) {
+                y[i] = 0.299 * r[i] + 0.587 * g[i] + 0.114 * b[i];
+                pb[i] = -0.168736 * r[i] - 0.331264 * g[i] + 0.5 * b[i];
+                pr[i] = 0.5 * r[i] - 0.418688 * g[i] - 0.081312 * b[i];
+        }
+}
+
+/* ypbpr_to_rgb_scalar
+ * Purpose: one pixel at a time, same expressions as compVid_to_RGBFloat
+ */
+static void ypbpr_to_rgb_scalar(const float *y, const float *pb, 
+                                const float *pr, float *r, float *g, 
+                                float *b, int n)
+{
+        for (int i = 0; i < n; i++) {
+                r[i] = 1.0 * y[i] + 0.0 * pb[i] + 1.402 * pr[i];
+                g[i] = 1.0 * y[i] - 0.344136 * pb[i] - 0.714136 * pr[i];
+                b[i] = 1.0 * y[i] + 1.772 * pb[i] + 0.0 * pr[i];
+        }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* ======================================================================
+                        SSE2 KERNELS (2 doubles per register)        
+   ====================================================================== */
+
+/* rgb_to_ypbpr_sse2
+ * Purpose: 8 pixels per iteration, in four pairs of packed doubles
+ */
+__attribute__((target("sse2")))
+static void rgb_to_ypbpr_sse2(const float *r, const float *g, const float *b,
+                              float *y, float *pb, float *pr, int n)
+{
+        const __m128d ky_r = _mm_set1_pd(0.299);
+        const __m128d ky_g = _mm_set1_pd(0.587);
+        const __m128d ky_b = _mm_set1_pd(0.114);
+        const __m128d kb_r = _mm_set1_pd(-0.168736);
+        const __m128d kb_g = _mm_set1_pd(0.331264);
+        const __m128d kb_b = _mm_set1_pd(0.5);
+        const __m128d kr_r = _mm_set1_pd(0.5);
+        const __m128d kr_g = _mm_set1_pd(0.418688);
+        const __m128d kr_b = _mm_set1_pd(0.081312);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                __m128 ys[4], pbs[4], prs[4];
+                for (int half = 0; half < 2; half++) {
+                        __m128 r4 = _mm_loadu_ps(&r[i + half * 4]);
+                        __m128 g4 = _mm_loadu_ps(&g[i + half * 4]);
+                        __m128 b4 = _mm_loadu_ps(&b[i + half * 4]);
+                        for (int k = 0; k < 2; k++) {
+                                __m128d rd = _mm_cvtps_pd(r4);
+                                __m128d gd = _mm_cvtps_pd(g4);
+                                __m128d bd = _mm_cvtps_pd(b4);
+
+                                __m128d yd = _mm_add_pd(_mm_add_pd(
+                                        _mm_mul_pd(ky_r, rd), 
+                                        _mm_mul_pd(ky_g, gd)), 
+                                        _mm_mul_pd(ky_b, bd));
+                                __m128d pbd = _mm_add_pd(_mm_sub_pd(
+                                        _mm_mul_pd(kb_r, rd), 
+                                        _mm_mul_pd(kb_g, gd)), 
+                                        _mm_mul_pd(kb_b, bd));
+                                __m128d prd = _mm_sub_pd(_mm_sub_pd(
+                                        _mm_mul_pd(kr_r, rd), 
+                                        _mm_mul_pd(kr_g, gd)), 
+                                        _mm_mul_pd(kr_b, bd));
+
+                                ys[half * 2 + k] = _mm_cvtpd_ps(yd);
+                                pbs[half * 2 + k] = _mm_cvtpd_ps(pbd);
+                                prs[half * 2 + k] = _mm_cvtpd_ps(prd);
+
+                                /* move the high two floats down */
+                                r4 = _mm_movehl_ps(r4, r4);
+                                g4 = _mm_movehl_ps(g4, g4);
+                                b4 = _mm_movehl_ps(b4, b4);
+                        }
+                }
+                for (int half = 0; half < 2; half++) {
+                        _mm_storeu_ps(&y[i + half * 4], _mm_movelh_ps(
+                                ys[half * 2], ys[half * 2 + 1]));
+                        _mm_storeu_ps(&pb[i + half * 4], _mm_movelh_ps(
+                                pbs[half * 2], pbs[half * 2 + 1]));
+                        _mm_storeu_ps(&pr[i + half * 4], _mm_movelh_ps(
+                                prs[half * 2], prs[half * 2 + 1]));
+                }
+        }
+        rgb_to_ypbpr_scalar(r + i, g + i, b + i, y + i, pb + i, pr + i, 
+                                                                n - i);
+}
+
+/* ypbpr_to_rgb_sse2
+ * Purpose: 8 pixels per iteration, in four pairs of packed doubles
+ */
+__attribute__((target("sse2")))
+static void ypbpr_to_rgb_sse2(const float *y, const float *pb, 
+                              const float *pr, float *r, float *g, float *b,
+                              int n)
+{
+        const __m128d one = _mm_set1_pd(1.0);
+        const __m128d zero = _mm_set1_pd(0.0);
+        const __m128d kr_pr = _mm_set1_pd(1.402);
+        const __m128d kg_pb = _mm_set1_pd(0.344136);
+        const __m128d kg_pr = _mm_set1_pd(0.714136);
+        const __m128d kb_pb = _mm_set1_pd(1.772);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                __m128 rs[4], gs[4], bs[4];
+                for (int half = 0; half < 2; half++) {
+                        __m128 y4 = _mm_loadu_ps(&y[i + half * 4]);
+                        __m128 pb4 = _mm_loadu_ps(&pb[i + half * 4]);
+                        __m128 pr4 = _mm_loadu_ps(&pr[i + half * 4]);
+                        for (int k = 0; k < 2; k++) {
+                                __m128d yd = _mm_mul_pd(one, 
+                                                        _mm_cvtps_pd(y4));
+                                __m128d pbd = _mm_cvtps_pd(pb4);
+                                __m128d prd = _mm_cvtps_pd(pr4);
+
+                                __m128d rd = _mm_add_pd(_mm_add_pd(yd, 
+                                        _mm_mul_pd(zero, pbd)), 
+                                        _mm_mul_pd(kr_pr, prd));
+                                __m128d gd = _mm_sub_pd(_mm_sub_pd(yd, 
+                                        _mm_mul_pd(kg_pb, pbd)), 
+                                        _mm_mul_pd(kg_pr, prd));
+                                __m128d bd = _mm_add_pd(_mm_add_pd(yd, 
+                                        _mm_mul_pd(kb_pb, pbd)), 
+                                        _mm_mul_pd(zero, prd));
+
+                                rs[half * 2 + k] = _mm_cvtpd_ps(rd);
+                                gs[half * 2 + k] = _mm_cvtpd_ps(gd);
+                                bs[half * 2 + k] = _mm_cvtpd_ps(bd);
+
+                                /* move the high two floats down */
+                                y4 = _mm_movehl_ps(y4, y4);
+                                pb4 = _mm_movehl_ps(pb4, pb4);
+                                pr4 = _mm_movehl_ps(pr4, pr4);
+                        }
+                }
+                for (int half = 0; half < 2; half++) {
+                        _mm_storeu_ps(&r[i + half * 4], _mm_movelh_ps(
+                                rs[half * 2], rs[half * 2 + 1]));
+                        _mm_storeu_ps(&g[i + half * 4], _mm_movelh_ps(
+                                gs[half * 2], gs[half * 2 + 1]));
+                        _mm_storeu_ps(&b[i + half * 4], _mm_movelh_ps(
+                                bs[half * 2], bs[half * 2 + 1]));
+                }
+        }
+        ypbpr_to_rgb_scalar(y + i, pb + i, pr + i, r + i, g + i, b + i, 
+                                                                n - i);
+}
+
+/* ======================================================================
+                        AVX2 KERNELS (4 doubles per register)        
+   ====================================================================== */
+
+/* rgb_to_ypbpr_avx2
+ * Purpose: 8 pixels per iteration, in two quads of packed doubles
+ */
+__attribute__((target("avx2")))
+static void rgb_to_ypbpr_avx2(const float *r, const float *g, const float *b,
+                              float *y, float *pb, float *pr, int n)
+{
+        const __m256d ky_r = _mm256_set1_pd(0.299);
+        const __m256d ky_g = _mm256_set1_pd(0.587);
+        const __m256d ky_b = _mm256_set1_pd(0.114);
+        const __m256d kb_r = _mm256_set1_pd(-0.168736);
+        const __m256d kb_g = _mm256_set1_pd(0.331264);
+        const __m256d kb_b = _mm256_set1_pd(0.5);
+        const __m256d kr_r = _mm256_set1_pd(0.5);
+        const __m256d kr_g = _mm256_set1_pd(0.418688);
+        const __m256d kr_b = _mm256_set1_pd(0.081312);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                for (int half = 0; half < 2; half++) {
+                        int at = i + half * 4;
+                        __m256d rd = _mm256_cvtps_pd(_mm_loadu_ps(&r[at]));
+                        __m256d gd = _mm256_cvtps_pd(_mm_loadu_ps(&g[at]));
+                        __m256d bd = _mm256_cvtps_pd(_mm_loadu_ps(&b[at]));
+
+                        __m256d yd = _mm256_add_pd(_mm256_add_pd(
+                                _mm256_mul_pd(ky_r, rd), 
+                                _mm256_mul_pd(ky_g, gd)), 
+                                _mm256_mul_pd(ky_b, bd));
+                        __m256d pbd = _mm256_add_pd(_mm256_sub_pd(
+                                _mm256_mul_pd(kb_r, rd), 
+                                _mm256_mul_pd(kb_g, gd)), 
+                                _mm256_mul_pd(kb_b, bd));
+                        __m256d prd = _mm256_sub_pd(_mm256_sub_pd(
+                                _mm256_mul_pd(kr_r, rd), 
+                                _mm256_mul_pd(kr_g, gd)), 
+                                _mm256_mul_pd(kr_b, bd));
+
+                        _mm_storeu_ps(&y[at], _mm256_cvtpd_ps(yd));
+                        _mm_storeu_ps(&pb[at], _mm256_cvtpd_ps(pbd));
+                        _mm_storeu_ps(&pr[at], _mm256_cvtpd_ps(prd));
+                }
+        }
+        rgb_to_ypbpr_scalar(r + i, g + i, b + i, y + i, pb + i, pr + i, 
+                                                                n - i);
+}
+
+/* ypbpr_to_rgb_avx2
+ * Purpose: 8 pixels per iteration, in two quads of packed doubles
+ */
+__attribute__((target("avx2")))
+static void ypbpr_to_rgb_avx2(const float *y, const float *pb, 
+                              const float *pr, float *r, float *g, float *b,
+                              int n)
+{
+        const __m256d one = _mm256_set1_pd(1.0);
+        const __m256d zero = _mm256_set1_pd(0.0);
+        const __m256d kr_pr = _mm256_set1_pd(1.402);
+        const __m256d kg_pb = _mm256_set1_pd(0.344136);
+        const __m256d kg_pr = _mm256_set1_pd(0.714136);
+        const __m256d kb_pb = _mm256_set1_pd(1.772);
+        int i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+                for (int half = 0; half < 2; half++) {
+                        int at = i + half * 4;
+                        __m256d yd = _mm256_mul_pd(one, 
+                                _mm256_cvtps_pd(_mm_loadu_ps(&y[at])));
+                        __m256d pbd = _mm256_cvtps_pd(_mm_loadu_ps(&pb[at]));
+                        __m256d prd = _mm256_cvtps_pd(_mm_loadu_ps(&pr[at]));
+
+                        __m256d rd = _mm256_add_pd(_mm256_add_pd(yd, 
+                                _mm256_mul_pd(zero, pbd)), 
+                                _mm256_mul_pd(kr_pr, prd));
+                        __m256d gd = _mm256_sub_pd(_mm256_sub_pd(yd, 
+                                _mm256_mul_pd(kg_pb, pbd)), 
+                                _mm256_mul_pd(kg_pr, prd));
+                        __m256d bd = _mm256_add_pd(_mm256_add_pd(yd, 
+                                _mm256_mul_pd(kb_pb, pbd)), 
+                                _mm256_mul_pd(zero, prd));
+
+                        _mm_storeu_ps(&r[at], _mm256_cvtpd_ps(rd));
+                        _mm_storeu_ps(&g[at], _mm256_cvtpd_ps(gd));
+                        _mm_storeu_ps(&b[at], _mm256_cvtpd_ps(bd));
+                }
+        }
+        ypbpr_to_rgb_scalar(y + i, pb + i, pr + i, r + i, g + i, b + i, 
+                                                                n - i);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* choose_kernels
+ * Purpose: picks the widest kernel this CPU supports, run once
+ */
+static void choose_kernels(void)
+{
+#ifdef HAVE_X86_SIMD
+        __builtin_cpu_init();
+#endif
+        if (!set_kernels("avx2") && !set_kernels("sse2")) {
+                set_kernels("scalar");
+        }
+}
+
+/* set_kernels
+ * Purpose: points the entry points at the named kernel
+ * Parameters: "avx2", "sse2" or "scalar"
+ * Returns: false, changing nothing, if this CPU can not run it
+ */
+static bool set_kernels(const char *name)
+{
+        if (strcmp(name, "scalar") == 0) {
+                rgb_to_ypbpr = rgb_to_ypbpr_scalar;
+                ypbpr_to_rgb = ypbpr_to_rgb_scalar;
+                kernel_name = "scalar";
+                return true;
+        }
+#ifdef HAVE_X86_SIMD
+        if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+                rgb_to_ypbpr = rgb_to_ypbpr_avx2;
+                ypbpr_to_rgb = ypbpr_to_rgb_avx2;
+                kernel_name = "avx2";
+                return true;
+        }
+        if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+                rgb_to_ypbpr = rgb_to_ypbpr_sse2;
+                ypbpr_to_rgb = ypbpr_to_rgb_sse2;
+                kernel_name = "sse2";
+                return true;
+        }
+#endif
+        return false;
+}
@@ -0,0 +1,29 @@
+/*
+ *     colorspace.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the row kernels that convert 
+ *      between RGB floats and component video (Y/Pb/Pr). Each kernel 
+ *      converts n pixels at once, from planar buffers (one array per 
+ *      channel). A SIMD version (AVX2 or SSE2) is picked at runtime when 
+ *      the CPU has it.
+ *     
+ */ 
+
+#ifndef COLORSPACE_H
+#define COLORSPACE_H
+
+#include "compression.h"
+
+/* planar buffers, n pixels each */
+void Colorspace_rgb_to_ypbpr(const float *r, const float *g, const float *b,
+                             float *y, float *pb, float *pr, int n);
+void Colorspace_ypbpr_to_rgb(const float *y, const float *pb, const float *pr,
+                             float *r, float *g, float *b, int n);
+
+/* name of the kernel in use: "avx2", "sse2" or "scalar" */
+const char *Colorspace_kernel(void);
+bool Colorspace_use_kernel(const char *name);
+
+#endif
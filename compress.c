@@ -19,10 +19,16 @@
 #include "compression.h"
 #include "mem.h"
 #include <math.h>
-#include "arith40.h"
 #include <stdint.h>
 #include <bitpack.h>
-
+#include "parallel.h"
+#include "colorspace.h"
+#include "dct.h"
+#include "chroma.h"
+#include "codeword.h"
+#include "a2spans.h"
+#include "stages.h"
+#include "stats.h"
 
 
 /* compressedImage
@@ -35,8 +41,9 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
 {
         A2Methods_T methods_plain = uarray2_methods_plain;
         A2Methods_T methods_blocked = uarray2_methods_blocked;
-        A2Methods_mapfun *mapRow = methods_plain->map_default;
         A2Methods_mapfun *mapBlocked = methods_blocked->map_default;
+        A2Methods_spanmapfun *mapRows = uarray2_spans_plain->map_rows;
+        A2Methods_mapfun *mapParallel = uarray2_spans_plain->map_parallel;
         A2Methods_UArray2 originalPixels = sourceImage->pixels;
         int denom = (int)sourceImage->denominator;
         
@@ -53,14 +60,16 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
                                                                  height, 
                                                   sizeof(struct rgbFloat));
         assert(RGB_float_uarray2 != NULL);
-        mapRow(RGB_float_uarray2, RGB_int_to_float, source_cl);
+        mapRows(RGB_float_uarray2, RGB_int_to_float, source_cl);
+        Stages_mark("rgb_int_to_float");
         
                         /*COMPRESS STEP 2: RGBFloat -> compVid */
         source_cl->array2 = RGB_float_uarray2;
         A2Methods_UArray2 compVid_uarray2 = methods_plain->new(width, 
                                                                height, 
                                                  sizeof(struct compVid));
-        mapRow(compVid_uarray2, RGB_to_compVid, source_cl);  
+        mapRows(compVid_uarray2, RGB_to_compVid, source_cl);  
+        Stages_mark("rgb_to_compvid");
         assert(compVid_uarray2 != NULL);
 
                         /* COMPRESSION STEP 2.5: plain -> blocked */
@@ -69,8 +78,11 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
                                         sizeof(struct compVid), 2);
         source_cl->array2 = compVid_uarray2_blocked;
         assert(compVid_uarray2_blocked != NULL);
-        /* row major mapping, source_cl contains destination blocked array */
-        mapRow(compVid_uarray2, plain_to_blocked, source_cl);
+        /* rows go to the threads, source_cl contains destination blocked 
+         * array 
+         */
+        mapParallel(compVid_uarray2, plain_to_blocked, source_cl);
+        Stages_mark("plain_to_blocked");
         /* from now on, our uarray2 is storing 2x2 blocks in a single cell, 
          * so we must update the overall width and height variables to account 
          * for that change 
@@ -84,12 +96,15 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
         assert(DCTFloat_uarray2 != NULL);
         blocked_cl endArray = new_blocked_cl(DCTFloat_uarray2, methods_plain);
         mapBlocked(compVid_uarray2_blocked, compVid_to_DCT, endArray);   
+        Stages_mark("compvid_to_dct");
 
                      /* COMPRESSION STEP 4: DCTFloat -> DCT_uInt*/
         A2Methods_UArray2 DCTInt_uarray2 = methods_plain->new(width, height, 
                                                 sizeof(struct DCT_uint)); 
         assert(DCTInt_uarray2 != NULL);   
-        mapRow(DCTInt_uarray2, DCTFloat_to_int, endArray); /* endarray = start*/
+        /* every cell is quantized on its own, so rows go to the threads */
+        mapParallel(DCTInt_uarray2, DCTFloat_to_int, endArray);
+        Stages_mark("dct_float_to_int");
 
                  /* COMPRESSION STEP 5 DCT_uInt -> codeword*/
         A2Methods_UArray2 codewords_uarray2 = methods_plain->new(width, height, 
@@ -97,7 +112,8 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
         assert(codewords_uarray2 != NULL);
         source_cl->array2 = DCTInt_uarray2;
         source_cl->methods = methods_plain;
-        mapRow(codewords_uarray2, pack_codeword, source_cl);
+        mapParallel(codewords_uarray2, pack_codeword, source_cl);
+        Stages_mark("pack_codeword");
 
         methods_plain->free(&RGB_float_uarray2);
         methods_plain->free(&compVid_uarray2);
@@ -114,64 +130,62 @@ A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage)
 
 
 /* RGB_int_to_float
- * Purpose: compression apply function that converts a UArray of RGBfloata  
- * Parameters: 
+ * Purpose: compression span apply function that converts a run of scaled
+ *              integer pixels to RGB floats, a whole row at a time
+ * Parameters: first column, row and length of the run, destination run, 
+ *              destination array, plain_cl closure holding the source image
  * Returns: N/A
  */  
-void RGB_int_to_float(int col, int row, A2Methods_UArray2 end_array, void *elem, void *cl)
+void RGB_int_to_float(int col, int row, int length, void *elems, 
+                      A2Methods_UArray2 end_array, void *cl)
 {
         (void) end_array;
         
         /* unpack the closure */
         struct plain_cl *start = cl;
-        A2Methods_T methods = start->methods;
-        A2Methods_UArray2 start_array = start->array2;
         int denominator = start->denom;
 
-        Pnm_rgb currInt = methods->at(start_array, col, row);
-        float r = ((float) (currInt->red)) / denominator;
-        float g = ((float) (currInt->green)) / denominator;
-        float b = ((float) (currInt->blue)) / denominator;
+        const struct Pnm_rgb *currInt = A2Methods_span_at(start->methods, 
+                                        start->array2, col, row, length);
+        struct rgbFloat *currFloat = elems;
 
-        struct rgbFloat *currFloat;
-        currFloat = (rgbFloat) elem;
-        
-        currFloat->red = r;
-        currFloat->green = g;
-        currFloat->blue = b;
+        for (int i = 0; i < length; i++) {
+                currFloat[i].red = ((float) (currInt[i].red)) / denominator;
+                currFloat[i].green = ((float) (currInt[i].green)) / 
+                                                                denominator;
+                currFloat[i].blue = ((float) (currInt[i].blue)) / denominator;
+        }
 }
 
 /* RGB_to_compVid
- * Purpose: compression apply function that completes the second step of 
- *              compression which converts a UArray of RGBfloats to a uarray 
- *              of compvid structs via mapping between two arrays  
- * Parameters: 
+ * Purpose: compression span apply function that completes the second step
+ *              of compression which converts a run of RGBfloats to compvid
+ *              structs via mapping between two arrays  
+ * Parameters: first column, row and length of the run, destination run, 
+ *              destination array, plain_cl closure holding the source array
  * Returns: N/A
  */ 
-void RGB_to_compVid(int col, int row, A2Methods_UArray2 end_array, void *elem, void *cl)
+void RGB_to_compVid(int col, int row, int length, void *elems, 
+                    A2Methods_UArray2 end_array, void *cl)
 {
         (void) end_array;
 
          /* unpack the closure */
         struct plain_cl *start = cl;
-        A2Methods_T methods = start->methods;
-        A2Methods_UArray2 start_array = start->array2; 
         
-        rgbFloat currFloat = methods->at(start_array, col, row);
-        float r = currFloat->red;
-        float g = currFloat->green;
-        float b = currFloat->blue;
-
-        float y = 0.299 * r + 0.587 * g + 0.114 * b;
-        float pb = -0.168736 * r - 0.331264 * g + 0.5 * b;
-        float pr = 0.5 * r - 0.418688 * g - 0.081312 * b;
-
-        struct compVid *currElem;
-        currElem = (compVid) elem;
-
-        currElem->y = y;
-        currElem->pb = pb;
-        currElem->pr = pr;
+        const struct rgbFloat *currFloat = A2Methods_span_at(start->methods,
+                                        start->array2, col, row, length);
+        struct compVid *currElem = elems;
+
+        for (int i = 0; i < length; i++) {
+                float r = currFloat[i].red;
+                float g = currFloat[i].green;
+                float b = currFloat[i].blue;
+
+                currElem[i].y = 0.299 * r + 0.587 * g + 0.114 * b;
+                currElem[i].pb = -0.168736 * r - 0.331264 * g + 0.5 * b;
+                currElem[i].pr = 0.5 * r - 0.418688 * g - 0.081312 * b;
+        }
 }
 
 /* plain_to_blocked
@@ -233,14 +247,36 @@ void compVid_to_DCT(int col, int row, A2Methods_UArray2 start_array, void *elem,
         }
         else {             /* column and row are both odd -> end of block */
                 currBlock->y4 = currElem->y;
-                DCT_float DCT_from_block = create_DCT(currBlock);
                 DCT_float currDCT = methods->at(end_array, col / 2, row / 2);
-                *currDCT = *DCT_from_block;
-                FREE(DCT_from_block);
+                set_DCT(currBlock, currDCT);
                 reset_block(currBlock);
         }                             
 }
 
+/* set_DCT
+ * Purpose: computes the discrete cosine transform of a full block straight
+ *              into the caller's storage, without a heap allocation per 
+ *              block
+ * Parameters: block holding the four y values and the chroma totals, 
+ *              destination DCT
+ * Returns: N/A
+ */
+void set_DCT(struct block *currBlock, DCT_float dest)
+{
+        assert(currBlock != NULL && dest != NULL);
+        float y1 = currBlock->y1;
+        float y2 = currBlock->y2;
+        float y3 = currBlock->y3;
+        float y4 = currBlock->y4;
+
+        dest->avgPb = currBlock->totalPb / 4.0;
+        dest->avgPr = currBlock->totalPr / 4.0;
+        dest->a = (y4 + y3 + y2 + y1) / 4.0;
+        dest->b = (y4 + y3 - y2 - y1) / 4.0;
+        dest->c = (y4 - y3 + y2 - y1) / 4.0;
+        dest->d = (y4 - y3 - y2 + y1) / 4.0;
+}
+
 /* compVid_to_DCT
  * Purpose: compression apply function that completes the step of 
  *              compression which converts a UArray of DCTfloat structs  
@@ -274,9 +310,9 @@ void DCTFloat_to_int(int col, int row, A2Methods_UArray2 dest_array, void *elem,
         destDCT->c = quantizeBCD(currDCT->c);
         destDCT->d = quantizeBCD(currDCT->d);
 
-        /*CODING PB AND PR using provided function */
-        destDCT->pb = Arith40_index_of_chroma(currDCT->avgPb);
-        destDCT->pr = Arith40_index_of_chroma(currDCT->avgPr); 
+        /*CODING PB AND PR with the chroma tables (see chroma.h) */
+        destDCT->pb = Chroma_index_of(currDCT->avgPb);
+        destDCT->pr = Chroma_index_of(currDCT->avgPr);
         
 }       
 
@@ -302,13 +338,10 @@ void pack_codeword(int col, int row, A2Methods_UArray2 dest_array, void *elem, v
 
         DCT_uint currDCTuInt = methods->at(start_array, col, row); 
 
-        /* bitpack everything */
-        *destWord = Bitpack_newu(*destWord, 6, 26, currDCTuInt->a);
-        *destWord = Bitpack_news(*destWord, 6, 20, currDCTuInt->b);
-        *destWord = Bitpack_news(*destWord, 6, 14, currDCTuInt->c);
-        *destWord = Bitpack_news(*destWord, 6, 8, currDCTuInt->d);
-        *destWord = Bitpack_newu(*destWord, 4, 4, currDCTuInt->pb);
-        *destWord = Bitpack_newu(*destWord, 4, 0, currDCTuInt->pr);
+        /* bitpack everything, the quantizers keep every field in range */
+        *destWord = Codeword_pack(currDCTuInt->a, currDCTuInt->b, 
+                                  currDCTuInt->c, currDCTuInt->d, 
+                                  currDCTuInt->pb, currDCTuInt->pr);
 }
 
 /* print_compressed
@@ -318,17 +351,71 @@ void pack_codeword(int col, int row, A2Methods_UArray2 dest_array, void *elem, v
  * Returns: N/A
  */
 void print_compressed(A2Methods_UArray2 codeword_uarray, A2Methods_T methods)
+{
+        write_compressed(codeword_uarray, methods, stdout);
+}
+
+/* write_compressed
+ * Purpose: writes the header and the codewords of a compressed image. 
+ *              Whole rows of codewords are gathered into one buffer of 
+ *              about OUTPUT_BUFFER bytes, byte swapped to big endian in 
+ *              bulk, and sent out with one fwrite per buffer instead of 
+ *              four putchar calls per codeword (see output_codeword)
+ * Parameters: UArray2 of codewords, methods to use on it, file to write to
+ * Returns: N/A
+ */
+void write_compressed(A2Methods_UArray2 codeword_uarray, A2Methods_T methods,
+                      FILE *output)
 {
         int width = methods->width(codeword_uarray);
         int height = methods->height(codeword_uarray);
-        printf("COMP40 Compressed image format 2\n%u %u\n", width, height);
-        methods->map_row_major(codeword_uarray, output_codeword, NULL);
+        int header = fprintf(output, "COMP40 Compressed image format 2\n"
+                             "%u %u\n", width, height);
+        assert(header > 0);
+        Stats_count_written(header);
+        if (width == 0 || height == 0) {
+                return;
+        }
+
+        int rowsPerBuffer = OUTPUT_BUFFER / (width * 4);
+        if (rowsPerBuffer < 1) {
+                rowsPerBuffer = 1;
+        }
+        if (rowsPerBuffer > height) {
+                rowsPerBuffer = height;
+        }
+        uint32_t *buffer = ALLOC((long) rowsPerBuffer * width * 
+                                 sizeof(uint32_t));
+
+        for (int firstRow = 0; firstRow < height; firstRow += rowsPerBuffer) {
+                int rows = (height - firstRow < rowsPerBuffer) ? 
+                                        height - firstRow : rowsPerBuffer;
+                long count = (long) rows * width;
+
+                for (int row = 0; row < rows; row++) {
+                        uint32_t *dest = &buffer[(long) row * width];
+                        for (int col = 0; col < width; col++) {
+                                dest[col] = *(uint32_t *) methods->at(
+                                        codeword_uarray, col, firstRow + row);
+                        }
+                }
+
+                /* swapped in place, the buffer now holds the output bytes */
+                Codeword_to_bigendian(buffer, count, 
+                                      (unsigned char *) buffer);
+                size_t written = fwrite(buffer, 4, count, output);
+                assert(written == (size_t) count);
+                Stats_count_written(4 * written);
+        }
+
+        FREE(buffer);
 }
 
 /* output_codeword
  * Purpose: compression apply function that completes the final step of 
  *              compression which outputs the uint32_t codewords to standard
- *              output. 
+ *              output. Kept as the reference for write_compressed, which 
+ *              writes the same bytes in bulk.
  * Parameters: source array in plain_cl struct passed as closure
  * Returns: N/A
  */
@@ -352,3 +439,282 @@ void output_codeword(int col, int row, A2Methods_UArray2 codeword_uarray, void *
         putchar(num3);
         putchar(num4);
 }
+
+
+/* ======================================================================
+                        FUSED COMPRESSION ENGINE        
+   ====================================================================== */
+
+struct compress_band_cl {
+        Pnm_ppm sourceImage;
+        A2Methods_UArray2 codewords;
+};
+
+/* source raster and destination bytes of fusedCompressedRaw */
+struct compress_raw_cl {
+        Rawppm image;
+        unsigned char *bytes;
+        int width;
+};
+
+static void compress_band(int firstRow, int lastRow, void *cl);
+static void compress_raw_band(int firstRow, int lastRow, void *cl);
+static inline void load_pixel(struct pixel_chunk *chunk, int i, 
+                              const struct Pnm_rgb *pixel, int denom);
+static inline void load_raw_pixel(struct pixel_chunk *chunk, int i, 
+                                  const unsigned char *px, int denom);
+static inline void load_raw_pixel16(struct pixel_chunk *chunk, int i, 
+                                    const unsigned char *px, int denom);
+static void encode_chunk(struct pixel_chunk *chunk, int blocks, 
+                         struct DCT_quant_batch *quant);
+
+/* fusedCompressedImage
+ * Purpose: single pass compression driver: reads each 2x2 block of the 
+ *          source image once and writes its codeword directly, skipping
+ *          the intermediate arrays built by compressedImage. Produces the
+ *          exact same codewords as compressedImage. Rows of blocks are
+ *          spread over Parallel_threads() threads; the output does not
+ *          depend on the thread count.
+ * Parameters: source image (pixels stored in a plain UArray2)
+ * Returns: Compressed Image as a UArray2_T of UInt_32s
+ */
+A2Methods_UArray2 fusedCompressedImage(Pnm_ppm sourceImage)
+{
+        A2Methods_T methods_plain = uarray2_methods_plain;
+
+        /* if width or height is not even, cut it down, then count blocks */
+        int width = makeEven((int) sourceImage->width) / 2;
+        int height = makeEven((int) sourceImage->height) / 2;
+
+        A2Methods_UArray2 codewords_uarray2 = methods_plain->new(width, height, 
+                                                        sizeof(uint32_t));
+        assert(codewords_uarray2 != NULL);
+
+        /* rows of blocks are independent, so encode them in bands, in 
+         * parallel if more than one thread was requested 
+         */
+        struct compress_band_cl band_cl = { sourceImage, codewords_uarray2 };
+        Parallel_map_bands(height, compress_band, &band_cl);
+
+        return codewords_uarray2;
+}
+
+/* compress_band
+ * Purpose: band apply function that compresses rows of blocks 
+ *              [firstRow, lastRow), possibly on its own thread
+ * Parameters: band of block rows, compress_band_cl closure
+ * Returns: N/A
+ */
+static void compress_band(int firstRow, int lastRow, void *cl)
+{
+        struct compress_band_cl *band_cl = cl;
+
+        for (int row = firstRow; row < lastRow; row++) {
+                compress_block_row(band_cl->sourceImage, band_cl->codewords, 
+                                                                        row);
+        }
+}
+
+/* compress_block_row
+ * Purpose: compresses one row of 2x2 blocks (two rows of pixels) from the
+ *              source image into the matching row of the codeword array,
+ *              ROW_CHUNK blocks at a time through the color row kernels
+ * Parameters: source image, destination codeword array, row of blocks
+ * Returns: N/A
+ */
+void compress_block_row(Pnm_ppm sourceImage, A2Methods_UArray2 codewords, 
+                                                        int blockRow)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_UArray2 pixels = sourceImage->pixels;
+        int denom = (int) sourceImage->denominator;
+        int width = methods->width(codewords);
+        int top = blockRow * 2;
+
+        struct pixel_chunk chunk;
+        struct DCT_quant_batch quant;
+        uint32_t chunkWords[ROW_CHUNK];
+
+        for (int start = 0; start < width; start += ROW_CHUNK) {
+                int blocks = (width - start < ROW_CHUNK) ? width - start 
+                                                         : ROW_CHUNK;
+                for (int k = 0; k < blocks; k++) {
+                        int left = (start + k) * 2;
+                        load_pixel(&chunk, k, 
+                                   methods->at(pixels, left, top), denom);
+                        load_pixel(&chunk, blocks + k, 
+                                   methods->at(pixels, left + 1, top), denom);
+                        load_pixel(&chunk, 2 * blocks + k, 
+                                   methods->at(pixels, left, top + 1), denom);
+                        load_pixel(&chunk, 3 * blocks + k, 
+                                   methods->at(pixels, left + 1, top + 1), 
+                                                                   denom);
+                }
+                encode_chunk(&chunk, blocks, &quant);
+                Codeword_pack_batch(&quant, blocks, chunkWords);
+                for (int k = 0; k < blocks; k++) {
+                        uint32_t *codeword = methods->at(codewords, 
+                                                         start + k, blockRow);
+                        *codeword = chunkWords[k];
+                }
+        }
+}
+
+/* fusedCompressedRaw
+ * Purpose: fusedCompressedImage for a native raw PPM: blocks are loaded 
+ *          straight from the contiguous 3 sample per pixel raster and their
+ *          codewords are stored as the big endian bytes of the compressed 
+ *          format, ready to be written with one fwrite. Produces the exact
+ *          same codewords as fusedCompressedImage.
+ * Parameters: image with a raster attached (see Rawppm_read_raster), 
+ *          destination of 4 bytes per block (width and height cut down to
+ *          even numbers, then halved)
+ * Returns: N/A
+ */
+void fusedCompressedRaw(Rawppm image, unsigned char *bytes)
+{
+        assert(image != NULL && image->raster != NULL);
+
+        int width = makeEven((int) image->width) / 2;
+        int height = makeEven((int) image->height) / 2;
+
+        struct compress_raw_cl band_cl = { image, bytes, width };
+        Parallel_map_bands(height, compress_raw_band, &band_cl);
+}
+
+/* compress_raw_band
+ * Purpose: band apply function that compresses rows of blocks 
+ *              [firstRow, lastRow) of a raw raster, possibly on its own 
+ *              thread
+ * Parameters: band of block rows, compress_raw_cl closure
+ * Returns: N/A
+ */
+static void compress_raw_band(int firstRow, int lastRow, void *cl)
+{
+        struct compress_raw_cl *band_cl = cl;
+        Rawppm image = band_cl->image;
+
+        for (int row = firstRow; row < lastRow; row++) {
+                const unsigned char *top = image->raster + 
+                                           (size_t) row * 2 * image->rowBytes;
+                compress_raw_rows(top, top + image->rowBytes, band_cl->width,
+                                  (int) image->bytesPerSample, 
+                                  (int) image->denominator, 
+                                  band_cl->bytes + 
+                                        (size_t) row * band_cl->width * 4);
+        }
+}
+
+/* compress_raw_rows
+ * Purpose: compresses two rows of a raw PPM raster into one row of 
+ *              codewords, ROW_CHUNK blocks at a time, stored as the big 
+ *              endian bytes of the compressed format
+ * Parameters: top and bottom raster rows (at least 2 * width pixels each),
+ *              number of blocks, bytes per sample (1, or 2 for big endian
+ *              16 bit samples), denominator, destination (4 * width bytes)
+ * Returns: N/A
+ */
+void compress_raw_rows(const unsigned char *top, const unsigned char *bottom,
+                       int width, int bytesPerSample, int denom, 
+                       unsigned char *bytes)
+{
+        struct pixel_chunk chunk;
+        struct DCT_quant_batch quant;
+        int pixelBytes = 3 * bytesPerSample;
+
+        for (int start = 0; start < width; start += ROW_CHUNK) {
+                int blocks = (width - start < ROW_CHUNK) ? width - start 
+                                                         : ROW_CHUNK;
+                const unsigned char *topRow = &top[start * 2 * pixelBytes];
+                const unsigned char *bottomRow = 
+                                        &bottom[start * 2 * pixelBytes];
+
+                /* one test per chunk rather than one per pixel */
+                if (bytesPerSample == 1) {
+                        for (int k = 0; k < blocks; k++) {
+                                const unsigned char *t = &topRow[6 * k];
+                                const unsigned char *b = &bottomRow[6 * k];
+                                load_raw_pixel(&chunk, k, t, denom);
+                                load_raw_pixel(&chunk, blocks + k, t + 3, 
+                                                                denom);
+                                load_raw_pixel(&chunk, 2 * blocks + k, b, 
+                                                                denom);
+                                load_raw_pixel(&chunk, 3 * blocks + k, b + 3,
+                                                                denom);
+                        }
+                } else {
+                        for (int k = 0; k < blocks; k++) {
+                                const unsigned char *t = &topRow[12 * k];
+                                const unsigned char *b = &bottomRow[12 * k];
+                                load_raw_pixel16(&chunk, k, t, denom);
+                                load_raw_pixel16(&chunk, blocks + k, t + 6, 
+                                                                denom);
+                                load_raw_pixel16(&chunk, 2 * blocks + k, b, 
+                                                                denom);
+                                load_raw_pixel16(&chunk, 3 * blocks + k, 
+                                                 b + 6, denom);
+                        }
+                }
+                encode_chunk(&chunk, blocks, &quant);
+                Codeword_pack_batch_be(&quant, blocks, &bytes[start * 4]);
+        }
+}
+
+/* load_pixel
+ * Purpose: stores one scaled integer pixel into a chunk as RGB floats, 
+ *              see RGB_int_to_float
+ * Parameters: chunk, index in the chunk, pixel, denominator
+ * Returns: N/A
+ */
+static inline void load_pixel(struct pixel_chunk *chunk, int i, 
+                              const struct Pnm_rgb *pixel, int denom)
+{
+        chunk->r[i] = ((float) (pixel->red)) / denom;
+        chunk->g[i] = ((float) (pixel->green)) / denom;
+        chunk->b[i] = ((float) (pixel->blue)) / denom;
+}
+
+/* load_raw_pixel
+ * Purpose: load_pixel for an 8 bit raw pixel
+ * Parameters: chunk, index in the chunk, 3 samples, denominator
+ * Returns: N/A
+ */
+static inline void load_raw_pixel(struct pixel_chunk *chunk, int i, 
+                                  const unsigned char *px, int denom)
+{
+        chunk->r[i] = ((float) px[0]) / denom;
+        chunk->g[i] = ((float) px[1]) / denom;
+        chunk->b[i] = ((float) px[2]) / denom;
+}
+
+/* load_raw_pixel16
+ * Purpose: load_pixel for a 16 bit raw pixel (big endian samples)
+ * Parameters: chunk, index in the chunk, 6 bytes of samples, denominator
+ * Returns: N/A
+ */
+static inline void load_raw_pixel16(struct pixel_chunk *chunk, int i, 
+                                    const unsigned char *px, int denom)
+{
+        chunk->r[i] = ((float) ((px[0] << 8) | px[1])) / denom;
+        chunk->g[i] = ((float) ((px[2] << 8) | px[3])) / denom;
+        chunk->b[i] = ((float) ((px[4] << 8) | px[5])) / denom;
+}
+
+/* encode_chunk
+ * Purpose: converts a whole chunk to component video with one call to the
+ *              row kernel, then runs the batched DCT and quantizer over it;
+ *              the caller packs the result with one bulk Codeword call
+ * Parameters: loaded chunk, number of blocks in it, destination quantized
+ *              blocks
+ * Returns: N/A
+ */
+static void encode_chunk(struct pixel_chunk *chunk, int blocks, 
+                         struct DCT_quant_batch *quant)
+{
+        struct DCT_batch dct;
+
+        Colorspace_rgb_to_ypbpr(chunk->r, chunk->g, chunk->b, 
+                                chunk->y, chunk->pb, chunk->pr, 4 * blocks);
+        Dct_forward_batch(chunk, blocks, &dct);
+        Dct_quantize_batch(&dct, blocks, quant);
+}
@@ -21,18 +21,84 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "mem.h"
+#include "rawppm.h"
 #include "bitpack.h"
+#include "stages.h"
+#include "stats.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void compress40_pnm(FILE *input);
 
 extern void compress40(FILE *input) /* reads PPM, writes compressed image */
 {
-        /*step 1, read from file*/
+        /*step 1, read from file: a raw PPM is mapped (or read) as is */
+        struct Rawppm sourceImage;
+        FILE *source = input;
+        if (!Rawppm_read_header(&source, &sourceImage)) {
+                /* any other format goes through netpbm, which reads source
+                 * from its start (a copy of a pipe's input, see rawppm.c)
+                 */
+                compress40_pnm(source);
+                if (source != input) {
+                        fclose(source);
+                }
+                return;
+        }
+        Rawppm_read_raster(input, &sourceImage);
+        Stages_mark("read");
+
+        /* if width or height is not even, cut it down, then count blocks */
+        unsigned width = makeEven((int) sourceImage.width) / 2;
+        unsigned height = makeEven((int) sourceImage.height) / 2;
+        size_t count = (size_t) width * height;
+        unsigned char *bytes = ALLOC(count * 4 + 1);
+
+        /*step 2, call (fused) driver straight on the raster */
+        fusedCompressedRaw(&sourceImage, bytes);
+        Stats_count_blocks(count);
+        Stages_mark("compress");
+
+        /*step 3, write the big endian code words with one fwrite */
+        int header = printf("COMP40 Compressed image format 2\n%u %u\n", 
+                            width, height);
+        assert(header > 0);
+        size_t written = fwrite(bytes, 4, count, stdout);
+        assert(written == count);
+        Stats_count_written(header + 4 * written);
+        Stages_mark("write");
+
+        FREE(bytes);
+        Rawppm_free_raster(&sourceImage);
+}
+
+/* compress40_pnm
+ * Purpose: compress40 for images that are not raw PPMs (such as plain 
+ *              P3 files): netpbm reads them into a UArray2 of Pnm_rgb
+ * Parameters: file to read the image from, at its first byte
+ * Returns: N/A
+ */
+static void compress40_pnm(FILE *input)
+{
+        /*step 1, read from file (netpbm does not say how much it read) */
+        long start = ftell(input);
         Pnm_ppm sourceImage = Pnm_ppmread(input, uarray2_methods_plain);
+        long end = ftell(input);
+        if (start >= 0 && end >= start) {
+                Stats_count_read(end - start);
+        }
+        Stages_mark("read");
 
-        /*step 2, call driver and save returned values*/
-        A2Methods_UArray2 compressedUArray2 = compressedImage(sourceImage);
+        /*step 2, call (fused) driver and save returned values*/
+        A2Methods_UArray2 compressedUArray2 = fusedCompressedImage(sourceImage);
+        Stats_count_blocks((uint64_t) 
+                uarray2_methods_plain->width(compressedUArray2) * 
+                uarray2_methods_plain->height(compressedUArray2));
+        Stages_mark("compress");
 
         /*write code words in row major, big endian order using putchar */
         print_compressed(compressedUArray2, uarray2_methods_plain);
+        Stages_mark("write");
         
         uarray2_methods_plain->free(&compressedUArray2);
         Pnm_ppmfree(&sourceImage);
@@ -40,14 +106,60 @@ extern void compress40(FILE *input) /* reads PPM, writes compressed image */
 
 extern void decompress40(FILE *input)  /* reads compressed image, writes PPM */
 {
-        /*step 1, read from file*/
-        A2Methods_UArray2 codewords_uarray2 = read_compressed(input);
+        unsigned width, height;
 
-        /*step 2, call driver and save returned values*/
-        A2Methods_UArray2 decomp_uarray2 = decompressedImage(codewords_uarray2);
+        /*step 1, read from file, see read_compressed */
+        read_compressed_header(input, &width, &height);
+        check_compressed_size(input, width, height);
+        unsigned char *bytes = read_codeword_bytes(input, width, height);
+        Stages_mark("read");
 
-        /*step 3, write to stdout*/
-        print_decompressed(decomp_uarray2);
+        /*step 2 and 3, decode straight into a raw raster and write it */
+        write_decompressed(bytes, width, height, stdout);
 
-        uarray2_methods_plain->free(&codewords_uarray2);
-}
\ No newline at end of file
+        FREE(bytes);
+}
+
+/* decompress40_mapped
+ * Purpose: decompress40 for a named file: the file is mapped into memory
+ *              and the codewords are decoded straight from the mapped pages,
+ *              instead of being copied into a buffer by read_codeword_bytes.
+ *              Falls back to reading the file if it can not be mapped.
+ * Parameters: compressed file (opened from a filename)
+ * Returns: N/A
+ */
+extern void decompress40_mapped(FILE *input)
+{
+        unsigned width, height;
+
+        /* step 1, read the header (and check the file is long enough) */
+        read_compressed_header(input, &width, &height);
+        check_compressed_size(input, width, height);
+        long offset = ftell(input);
+
+        struct stat info;
+        void *map = MAP_FAILED;
+        size_t length = 0;
+        if (offset >= 0 && fstat(fileno(input), &info) == 0 && 
+            S_ISREG(info.st_mode) && info.st_size > 0) {
+                length = info.st_size;
+                map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, 
+                           fileno(input), 0);
+        }
+
+        /* step 2 and 3, decode the mapped or the read codewords */
+        if (map != MAP_FAILED) {
+                madvise(map, length, MADV_SEQUENTIAL);
+                Stats_count_read(4 * (uint64_t) width * height);
+                Stages_mark("read");
+                write_decompressed((unsigned char *) map + offset, width, 
+                                   height, stdout);
+                munmap(map, length);
+        } else {
+                unsigned char *bytes = read_codeword_bytes(input, width, 
+                                                           height);
+                Stages_mark("read");
+                write_decompressed(bytes, width, height, stdout);
+                FREE(bytes);
+        }
+}
@@ -16,14 +16,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "pnm.h"
 #include "assert.h"
+#include "except.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
 #include "uarray2.h"
 #include "arith40.h"
 #include <bitpack.h>
+#include "rawppm.h"
 
 /* --------------- PIXEL STORAGE STRUCTS ------------------ */
 
@@ -62,23 +65,90 @@ typedef struct DCT_uint {
         int b, c, d;
 } *DCT_uint;
 
+/* size in bytes of the buffer write_compressed fills before each fwrite */
+#define OUTPUT_BUFFER (1 << 20)
+/* size in bytes of each fread of read_codewords */
+#define INPUT_BUFFER (1 << 20)
+
+/* raised when a compressed image ends before its last codeword */
+extern Except_T Compressed_Truncated;
+
+/* number of 2x2 blocks the fused engines convert at a time */
+#define ROW_CHUNK 128
+
+/* planar scratch for the fused engines: a chunk of n blocks holds the top
+ * left pixel of every block at [0, n), the top right pixels at [n, 2n), the
+ * bottom left pixels at [2n, 3n) and the bottom right pixels at [3n, 4n)
+ */
+struct pixel_chunk {
+        float r[4 * ROW_CHUNK], g[4 * ROW_CHUNK], b[4 * ROW_CHUNK];
+        float y[4 * ROW_CHUNK], pb[4 * ROW_CHUNK], pr[4 * ROW_CHUNK];
+};
+
 
 /* --------------- FUNCTIONS FOR CLIENT TO CALL ------------------ */ 
 
 A2Methods_UArray2 compressedImage(Pnm_ppm sourceImage);
 void print_compressed(A2Methods_UArray2 codeword_uarray, A2Methods_T methods);
+void write_compressed(A2Methods_UArray2 codeword_uarray, A2Methods_T methods,
+                      FILE *output);
 UArray2_T read_compressed(FILE *fp);
+void read_compressed_header(FILE *fp, unsigned *width, unsigned *height);
+void check_compressed_size(FILE *fp, unsigned width, unsigned height);
+void read_codewords(FILE *fp, A2Methods_UArray2 codewords, 
+                    A2Methods_T methods);
+unsigned char *read_codeword_bytes(FILE *fp, unsigned width, 
+                                   unsigned height);
 A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2);
 void print_decompressed(A2Methods_UArray2 rgb_decomp_uarray2);
+void write_decompressed(const unsigned char *bytes, unsigned width, 
+                        unsigned height, FILE *output);
+
+/* ======================================================================
+                        FUSED COMPRESSION ENGINE        
+   ====================================================================== */
+
+A2Methods_UArray2 fusedCompressedImage(Pnm_ppm sourceImage);
+void compress_block_row(Pnm_ppm sourceImage, A2Methods_UArray2 codewords,
+                                                        int blockRow);
+void fusedCompressedRaw(Rawppm image, unsigned char *bytes);
+void compress_raw_rows(const unsigned char *top, const unsigned char *bottom,
+                       int width, int bytesPerSample, int denom, 
+                       unsigned char *bytes);
+
+/* ======================================================================
+                        STREAMING COMPRESSION AND DECOMPRESSION
+   ====================================================================== */
+
+void compress40_stream(FILE *input);
+void decompress40_stream(FILE *input);
+
+/* ======================================================================
+                        MAPPED DECOMPRESSION
+   ====================================================================== */
+
+void decompress40_mapped(FILE *input);
+
+/* ======================================================================
+                        FUSED DECOMPRESSION ENGINE        
+   ====================================================================== */
+
+A2Methods_UArray2 fusedDecompressedImage(A2Methods_UArray2 codewords_uarray2);
+void decompress_block_row(A2Methods_UArray2 codewords, 
+                          A2Methods_UArray2 pixels, int blockRow);
+void fusedDecompressedRaw(const unsigned char *bytes, int width, int height,
+                          unsigned char *raster);
+void decompress_raw_row(const unsigned char *bytes, int width, 
+                        unsigned char *top, unsigned char *bottom);
 
 /* ======================================================================
                         COMPRESSION APPLY FUNCTIONS        
    ====================================================================== */
 
-void RGB_int_to_float(int col, int row, A2Methods_UArray2 end_array, void *elem,
-                                                        void *cl);
-void RGB_to_compVid(int col, int row, A2Methods_UArray2 end_array, void *elem,
-                                                                 void *cl);
+void RGB_int_to_float(int col, int row, int length, void *elems, 
+                      A2Methods_UArray2 end_array, void *cl);
+void RGB_to_compVid(int col, int row, int length, void *elems, 
+                    A2Methods_UArray2 end_array, void *cl);
 void plain_to_blocked (int col, int row, A2Methods_UArray2 end_array, 
                                                         void *elem, void *cl);
 void compVid_to_DCT(int col, int row, A2Methods_UArray2 end_array, 
@@ -94,10 +164,10 @@ void output_codeword(int col, int row, A2Methods_UArray2 codeword_uarray,
                         DECOMPRESSION APPLY FUNCTIONS        
    ====================================================================== */
 
-void RGB_float_to_int(int col, int row, A2Methods_UArray2 end_array, 
-                                                        void *elem, void *cl);
-void compVid_to_RGBFloat(int col, int row, A2Methods_UArray2 end_array, 
-                                                        void *elem, void *cl);
+void RGB_float_to_int(int col, int row, int length, void *elems, 
+                      A2Methods_UArray2 end_array, void *cl);
+void compVid_to_RGBFloat(int col, int row, int length, void *elems, 
+                         A2Methods_UArray2 end_array, void *cl);
 void DCT_to_compVid(int col, int row, A2Methods_UArray2 start_array, 
                                                         void *elem, void *cl);
 void blocked_to_plain (int col, int row, A2Methods_UArray2 end_array, 
@@ -124,8 +194,8 @@ void reset_block(block newBlock);
 int squash_into_range(int lower, int upper, int num);
 int quantizeBCD(float x);
 float unquantizeBCD(int x);
-DCT_float create_DCT(struct block *currBlock);
-compVid createCompVid(DCT_float currDCT, int col, int row);
+void set_DCT(struct block *currBlock, DCT_float dest);
+void setCompVid(DCT_float currDCT, int col, int row, compVid dest);
 
 /*    DEBUGGING PRINT FUNCTIONS */
 void printFloats(int i, int j, A2Methods_UArray2 array2, void *elem, void *cl);
@@ -0,0 +1,602 @@
+/*
+ *     dct.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the batched DCT kernels 
+ *      whose declarations are included in dct.h. 
+ *
+ *     Every kernel gives bit for bit the same results as the one block at a
+ *      time code in compress.c and decompress.c:
+ *      - the DCT sums are done in float in the same order, and scaling by
+ *        0.25f is exact, so it rounds just like dividing by 4.0 in double
+ *      - a is quantized as round(a * 63.0) in packed doubles; a is never
+ *        negative, so floor(x + 0.5) is the same as round(x)
+ *      - b, c and d are quantized with a branchless binary search over the
+ *        thresholds where quantizeBCD steps to its next level. The 
+ *        thresholds are found once at startup by bisecting quantizeBCD 
+ *        itself over [-1, 1] (the coefficients never leave [-0.5, 0.5]),
+ *        so they match it exactly on every float in that range
+ *      - unquantizing looks up tables filled in with the scalar helpers
+ *      - the chroma averages go through the chroma.c tables, a whole 
+ *        batch at a time
+ *     
+ *     The SSE2 kernels only cover the DCT itself; the table lookups need 
+ *      the AVX2 gather instructions, so without AVX2 they run scalar.
+ *     
+ */ 
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "assert.h"
+#include "chroma.h"
+#include "dct.h"
+#include "floatkey.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* quantizeBCD is searched over [-BCD_RANGE, BCD_RANGE] */
+#define BCD_RANGE 1.0f
+/* bcd_thresholds[j] is the smallest float that quantizes to bcd_min + j + 1
+ * or more; unused slots hold +infinity 
+ */
+static float bcd_thresholds[DCT_BCD_LEVELS];
+static int bcd_min;
+/* unquantized values of every 6 bit code: a_levels[a], bcd_levels[b + 32] */
+static float a_levels[DCT_BCD_LEVELS];
+static float bcd_levels[DCT_BCD_LEVELS];
+
+typedef void forward_fun(const struct pixel_chunk *chunk, int n, 
+                         struct DCT_batch *dct, int start);
+typedef void inverse_fun(const struct DCT_batch *dct, int n, 
+                         struct pixel_chunk *chunk, int start);
+typedef void quantize_fun(const struct DCT_batch *dct, int n, 
+                          struct DCT_quant_batch *quant, int start);
+typedef void unquantize_fun(const struct DCT_quant_batch *quant, int n, 
+                            struct DCT_batch *dct, int start);
+
+static forward_fun forward_scalar;
+static inverse_fun inverse_scalar;
+static quantize_fun quantize_scalar;
+static unquantize_fun unquantize_scalar;
+
+static forward_fun *forward = forward_scalar;
+static inverse_fun *inverse = inverse_scalar;
+static quantize_fun *quantize = quantize_scalar;
+static unquantize_fun *unquantize = unquantize_scalar;
+static const char *kernel_name = "scalar";
+static pthread_once_t dct_once = PTHREAD_ONCE_INIT;
+
+static void setup(void);
+static bool set_kernels(const char *name);
+static void build_tables(void);
+
+/* ======================================================================
+                        PUBLIC ENTRY POINTS        
+   ====================================================================== */
+
+/* Dct_forward_batch
+ * Purpose: computes the DCT of n blocks of a chunk, see set_DCT
+ * Parameters: chunk holding the compVids, number of blocks, destination
+ * Returns: N/A
+ */
+void Dct_forward_batch(const struct pixel_chunk *chunk, int n, 
+                       struct DCT_batch *dct)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&dct_once, setup);
+        forward(chunk, n, dct, 0);
+}
+
+/* Dct_inverse_batch
+ * Purpose: computes the compVids of n blocks from their DCT, filling in
+ *              the y, pb and pr planes of the chunk
+ * Parameters: DCT of the blocks, number of blocks, destination chunk
+ * Returns: N/A
+ */
+void Dct_inverse_batch(const struct DCT_batch *dct, int n, 
+                       struct pixel_chunk *chunk)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&dct_once, setup);
+        inverse(dct, n, chunk, 0);
+}
+
+/* Dct_quantize_batch
+ * Purpose: quantizes the DCT of n blocks, see DCTFloat_to_int
+ * Parameters: DCT of the blocks, number of blocks, destination
+ * Returns: N/A
+ */
+void Dct_quantize_batch(const struct DCT_batch *dct, int n, 
+                        struct DCT_quant_batch *quant)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&dct_once, setup);
+        quantize(dct, n, quant, 0);
+        Chroma_index_batch(dct->avgPb, quant->pb, n);
+        Chroma_index_batch(dct->avgPr, quant->pr, n);
+}
+
+/* Dct_unquantize_batch
+ * Purpose: unquantizes the DCT of n blocks, see DCTint_to_float
+ * Parameters: quantized DCT of the blocks, number of blocks, destination
+ * Returns: N/A
+ */
+void Dct_unquantize_batch(const struct DCT_quant_batch *quant, int n, 
+                          struct DCT_batch *dct)
+{
+        assert(n >= 0 && n <= ROW_CHUNK);
+        pthread_once(&dct_once, setup);
+        unquantize(quant, n, dct, 0);
+        Chroma_of_index_batch(quant->pb, dct->avgPb, n);
+        Chroma_of_index_batch(quant->pr, dct->avgPr, n);
+}
+
+/* Dct_kernel
+ * Purpose: reports which kernels were picked for this CPU
+ * Parameters: N/A
+ * Returns: "avx2", "sse2" or "scalar"
+ */
+const char *Dct_kernel(void)
+{
+        pthread_once(&dct_once, setup);
+        return kernel_name;
+}
+
+/* Dct_use_kernel
+ * Purpose: switches to the given kernels, so the tests can run every one;
+ *              not to be called while other threads use the kernels
+ * Parameters: "avx2", "sse2" or "scalar"
+ * Returns: false (and the kernels in use are kept) if this CPU can not run
+ *              them
+ */
+bool Dct_use_kernel(const char *name)
+{
+        assert(name != NULL);
+        pthread_once(&dct_once, setup);
+        return set_kernels(name);
+}
+
+/* Dct_bcd_thresholds
+ * Purpose: copies out the quantizeBCD thresholds the AVX2 quantizer 
+ *              searches, so the tests can check them against quantizeBCD
+ * Parameters: array of DCT_BCD_LEVELS floats to fill in, lowest level 
+ *              (what quantizeBCD gives below the first threshold)
+ * Returns: number of thresholds: thresholds[j] is the smallest float that
+ *              quantizes to *lowest + j + 1 or more
+ */
+int Dct_bcd_thresholds(float *thresholds, int *lowest)
+{
+        assert(thresholds != NULL && lowest != NULL);
+        pthread_once(&dct_once, setup);
+
+        int count = 0;
+        while (count < DCT_BCD_LEVELS && !isinf(bcd_thresholds[count])) {
+                thresholds[count] = bcd_thresholds[count];
+                count++;
+        }
+        *lowest = bcd_min;
+
+        return count;
+}
+
+/* ======================================================================
+                        SCALAR KERNELS (blocks [start, n))        
+   ====================================================================== */
+
+static void forward_scalar(const struct pixel_chunk *chunk, int n, 
+                           struct DCT_batch *dct, int start)
+{
+        const float *y = chunk->y;
+        const float *pb = chunk->pb;
+        const float *pr = chunk->pr;
+
+        for (int k = start; k < n; k++) {
+                float y1 = y[k];
+                float y2 = y[n + k];
+                float y3 = y[2 * n + k];
+                float y4 = y[3 * n + k];
+
+                /* chroma totals are summed in map order */
+                float totalPb = 0.0;
+                float totalPr = 0.0;
+                for (int plane = 0; plane < 4; plane++) {
+                        totalPb += pb[plane * n + k];
+                        totalPr += pr[plane * n + k];
+                }
+
+                dct->avgPb[k] = totalPb / 4.0;
+                dct->avgPr[k] = totalPr / 4.0;
+                dct->a[k] = (y4 + y3 + y2 + y1) / 4.0;
+                dct->b[k] = (y4 + y3 - y2 - y1) / 4.0;
+                dct->c[k] = (y4 - y3 + y2 - y1) / 4.0;
+                dct->d[k] = (y4 - y3 - y2 + y1) / 4.0;
+        }
+}
+
+static void inverse_scalar(const struct DCT_batch *dct, int n, 
+                           struct pixel_chunk *chunk, int start)
+{
+        for (int k = start; k < n; k++) {
+                float a = dct->a[k];
+                float b = dct->b[k];
+                float c = dct->c[k];
+                float d = dct->d[k];
+
+                chunk->y[k] = a - b - c + d;
+                chunk->y[n + k] = a - b + c - d;
+                chunk->y[2 * n + k] = a + b - c - d;
+                chunk->y[3 * n + k] = a + b + c + d;
+                for (int plane = 0; plane < 4; plane++) {
+                        chunk->pb[plane * n + k] = dct->avgPb[k];
+                        chunk->pr[plane * n + k] = dct->avgPr[k];
+                }
+        }
+}
+
+static void quantize_scalar(const struct DCT_batch *dct, int n, 
+                            struct DCT_quant_batch *quant, int start)
+{
+        for (int k = start; k < n; k++) {
+                quant->a[k] = (unsigned) round(dct->a[k] * 63.0);
+                quant->b[k] = quantizeBCD(dct->b[k]);
+                quant->c[k] = quantizeBCD(dct->c[k]);
+                quant->d[k] = quantizeBCD(dct->d[k]);
+        }
+}
+
+static void unquantize_scalar(const struct DCT_quant_batch *quant, int n, 
+                              struct DCT_batch *dct, int start)
+{
+        for (int k = start; k < n; k++) {
+                dct->a[k] = a_levels[quant->a[k]];
+                dct->b[k] = bcd_levels[quant->b[k] + 32];
+                dct->c[k] = bcd_levels[quant->c[k] + 32];
+                dct->d[k] = bcd_levels[quant->d[k] + 32];
+        }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* ======================================================================
+                        SSE2 KERNELS (4 blocks per iteration)        
+   ====================================================================== */
+
+__attribute__((target("sse2")))
+static void forward_sse2(const struct pixel_chunk *chunk, int n, 
+                         struct DCT_batch *dct, int start)
+{
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const float *y = chunk->y;
+        const float *pb = chunk->pb;
+        const float *pr = chunk->pr;
+        int k = start;
+
+        for (; k + 4 <= n; k += 4) {
+                __m128 y1 = _mm_loadu_ps(&y[k]);
+                __m128 y2 = _mm_loadu_ps(&y[n + k]);
+                __m128 y3 = _mm_loadu_ps(&y[2 * n + k]);
+                __m128 y4 = _mm_loadu_ps(&y[3 * n + k]);
+                __m128 totalPb = _mm_setzero_ps();
+                __m128 totalPr = _mm_setzero_ps();
+                for (int plane = 0; plane < 4; plane++) {
+                        totalPb = _mm_add_ps(totalPb, 
+                                        _mm_loadu_ps(&pb[plane * n + k]));
+                        totalPr = _mm_add_ps(totalPr, 
+                                        _mm_loadu_ps(&pr[plane * n + k]));
+                }
+
+                __m128 sum34 = _mm_add_ps(y4, y3);
+                __m128 dif34 = _mm_sub_ps(y4, y3);
+                _mm_storeu_ps(&dct->avgPb[k], _mm_mul_ps(totalPb, quarter));
+                _mm_storeu_ps(&dct->avgPr[k], _mm_mul_ps(totalPr, quarter));
+                _mm_storeu_ps(&dct->a[k], _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+                                        sum34, y2), y1), quarter));
+                _mm_storeu_ps(&dct->b[k], _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(
+                                        sum34, y2), y1), quarter));
+                _mm_storeu_ps(&dct->c[k], _mm_mul_ps(_mm_sub_ps(_mm_add_ps(
+                                        dif34, y2), y1), quarter));
+                _mm_storeu_ps(&dct->d[k], _mm_mul_ps(_mm_add_ps(_mm_sub_ps(
+                                        dif34, y2), y1), quarter));
+        }
+        forward_scalar(chunk, n, dct, k);
+}
+
+__attribute__((target("sse2")))
+static void inverse_sse2(const struct DCT_batch *dct, int n, 
+                         struct pixel_chunk *chunk, int start)
+{
+        int k = start;
+
+        for (; k + 4 <= n; k += 4) {
+                __m128 a = _mm_loadu_ps(&dct->a[k]);
+                __m128 b = _mm_loadu_ps(&dct->b[k]);
+                __m128 c = _mm_loadu_ps(&dct->c[k]);
+                __m128 d = _mm_loadu_ps(&dct->d[k]);
+                __m128 avgPb = _mm_loadu_ps(&dct->avgPb[k]);
+                __m128 avgPr = _mm_loadu_ps(&dct->avgPr[k]);
+                __m128 amb = _mm_sub_ps(a, b);
+                __m128 apb = _mm_add_ps(a, b);
+
+                _mm_storeu_ps(&chunk->y[k], _mm_add_ps(_mm_sub_ps(amb, c), 
+                                                                        d));
+                _mm_storeu_ps(&chunk->y[n + k], _mm_sub_ps(_mm_add_ps(amb, 
+                                                                c), d));
+                _mm_storeu_ps(&chunk->y[2 * n + k], _mm_sub_ps(_mm_sub_ps(
+                                                        apb, c), d));
+                _mm_storeu_ps(&chunk->y[3 * n + k], _mm_add_ps(_mm_add_ps(
+                                                        apb, c), d));
+                for (int plane = 0; plane < 4; plane++) {
+                        _mm_storeu_ps(&chunk->pb[plane * n + k], avgPb);
+                        _mm_storeu_ps(&chunk->pr[plane * n + k], avgPr);
+                }
+        }
+        inverse_scalar(dct, n, chunk, k);
+}
+
+/* ======================================================================
+                        AVX2 KERNELS (8 blocks per iteration)        
+   ====================================================================== */
+
+__attribute__((target("avx2")))
+static void forward_avx2(const struct pixel_chunk *chunk, int n, 
+                         struct DCT_batch *dct, int start)
+{
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const float *y = chunk->y;
+        const float *pb = chunk->pb;
+        const float *pr = chunk->pr;
+        int k = start;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256 y1 = _mm256_loadu_ps(&y[k]);
+                __m256 y2 = _mm256_loadu_ps(&y[n + k]);
+                __m256 y3 = _mm256_loadu_ps(&y[2 * n + k]);
+                __m256 y4 = _mm256_loadu_ps(&y[3 * n + k]);
+                __m256 totalPb = _mm256_setzero_ps();
+                __m256 totalPr = _mm256_setzero_ps();
+                for (int plane = 0; plane < 4; plane++) {
+                        totalPb = _mm256_add_ps(totalPb, 
+                                        _mm256_loadu_ps(&pb[plane * n + k]));
+                        totalPr = _mm256_add_ps(totalPr, 
+                                        _mm256_loadu_ps(&pr[plane * n + k]));
+                }
+
+                __m256 sum34 = _mm256_add_ps(y4, y3);
+                __m256 dif34 = _mm256_sub_ps(y4, y3);
+                _mm256_storeu_ps(&dct->avgPb[k], 
+                                 _mm256_mul_ps(totalPb, quarter));
+                _mm256_storeu_ps(&dct->avgPr[k], 
+                                 _mm256_mul_ps(totalPr, quarter));
+                _mm256_storeu_ps(&dct->a[k], _mm256_mul_ps(_mm256_add_ps(
+                        _mm256_add_ps(sum34, y2), y1), quarter));
+                _mm256_storeu_ps(&dct->b[k], _mm256_mul_ps(_mm256_sub_ps(
+                        _mm256_sub_ps(sum34, y2), y1), quarter));
+                _mm256_storeu_ps(&dct->c[k], _mm256_mul_ps(_mm256_sub_ps(
+                        _mm256_add_ps(dif34, y2), y1), quarter));
+                _mm256_storeu_ps(&dct->d[k], _mm256_mul_ps(_mm256_add_ps(
+                        _mm256_sub_ps(dif34, y2), y1), quarter));
+        }
+        forward_scalar(chunk, n, dct, k);
+}
+
+__attribute__((target("avx2")))
+static void inverse_avx2(const struct DCT_batch *dct, int n, 
+                         struct pixel_chunk *chunk, int start)
+{
+        int k = start;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256 a = _mm256_loadu_ps(&dct->a[k]);
+                __m256 b = _mm256_loadu_ps(&dct->b[k]);
+                __m256 c = _mm256_loadu_ps(&dct->c[k]);
+                __m256 d = _mm256_loadu_ps(&dct->d[k]);
+                __m256 avgPb = _mm256_loadu_ps(&dct->avgPb[k]);
+                __m256 avgPr = _mm256_loadu_ps(&dct->avgPr[k]);
+                __m256 amb = _mm256_sub_ps(a, b);
+                __m256 apb = _mm256_add_ps(a, b);
+
+                _mm256_storeu_ps(&chunk->y[k], _mm256_add_ps(
+                                        _mm256_sub_ps(amb, c), d));
+                _mm256_storeu_ps(&chunk->y[n + k], _mm256_sub_ps(
+                                        _mm256_add_ps(amb, c), d));
+                _mm256_storeu_ps(&chunk->y[2 * n + k], _mm256_sub_ps(
+                                        _mm256_sub_ps(apb, c), d));
+                _mm256_storeu_ps(&chunk->y[3 * n + k], _mm256_add_ps(
+                                        _mm256_add_ps(apb, c), d));
+                for (int plane = 0; plane < 4; plane++) {
+                        _mm256_storeu_ps(&chunk->pb[plane * n + k], avgPb);
+                        _mm256_storeu_ps(&chunk->pr[plane * n + k], avgPr);
+                }
+        }
+        inverse_scalar(dct, n, chunk, k);
+}
+
+/* quantize_bcd_avx2
+ * Purpose: quantizeBCD on 8 floats: counts the thresholds at or below each
+ *              value with a 6 step branchless binary search
+ */
+__attribute__((target("avx2")))
+static inline __m256i quantize_bcd_avx2(__m256 x)
+{
+        __m256i count = _mm256_setzero_si256();
+
+        for (int step = DCT_BCD_LEVELS / 2; step >= 1; step /= 2) {
+                __m256i next = _mm256_add_epi32(count, 
+                                                _mm256_set1_epi32(step));
+                __m256 threshold = _mm256_i32gather_ps(bcd_thresholds, 
+                        _mm256_sub_epi32(next, _mm256_set1_epi32(1)), 4);
+                __m256 atLeast = _mm256_cmp_ps(x, threshold, _CMP_GE_OQ);
+                count = _mm256_blendv_epi8(count, next, 
+                                           _mm256_castps_si256(atLeast));
+        }
+
+        return _mm256_add_epi32(count, _mm256_set1_epi32(bcd_min));
+}
+
+/* quantize_a_avx2
+ * Purpose: round(a * 63.0) on 8 floats, in two quads of packed doubles
+ */
+__attribute__((target("avx2")))
+static inline __m256i quantize_a_avx2(__m256 a)
+{
+        const __m256d scale = _mm256_set1_pd(63.0);
+        const __m256d half = _mm256_set1_pd(0.5);
+
+        __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(a));
+        __m256d high = _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+        low = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(low, scale), half));
+        high = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(high, scale), 
+                                                                half));
+
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(
+                                _mm256_cvttpd_epi32(low)), 
+                                _mm256_cvttpd_epi32(high), 1);
+}
+
+__attribute__((target("avx2")))
+static void quantize_avx2(const struct DCT_batch *dct, int n, 
+                          struct DCT_quant_batch *quant, int start)
+{
+        int k = start;
+
+        for (; k + 8 <= n; k += 8) {
+                _mm256_storeu_si256((__m256i *) &quant->a[k], 
+                        quantize_a_avx2(_mm256_loadu_ps(&dct->a[k])));
+                _mm256_storeu_si256((__m256i *) &quant->b[k], 
+                        quantize_bcd_avx2(_mm256_loadu_ps(&dct->b[k])));
+                _mm256_storeu_si256((__m256i *) &quant->c[k], 
+                        quantize_bcd_avx2(_mm256_loadu_ps(&dct->c[k])));
+                _mm256_storeu_si256((__m256i *) &quant->d[k], 
+                        quantize_bcd_avx2(_mm256_loadu_ps(&dct->d[k])));
+        }
+        quantize_scalar(dct, n, quant, k);
+}
+
+__attribute__((target("avx2")))
+static void unquantize_avx2(const struct DCT_quant_batch *quant, int n, 
+                            struct DCT_batch *dct, int start)
+{
+        const __m256i offset = _mm256_set1_epi32(32);
+        int k = start;
+
+        for (; k + 8 <= n; k += 8) {
+                __m256i a = _mm256_loadu_si256((__m256i *) &quant->a[k]);
+                __m256i b = _mm256_loadu_si256((__m256i *) &quant->b[k]);
+                __m256i c = _mm256_loadu_si256((__m256i *) &quant->c[k]);
+                __m256i d = _mm256_loadu_si256((__m256i *) &quant->d[k]);
+
+                _mm256_storeu_ps(&dct->a[k], 
+                                 _mm256_i32gather_ps(a_levels, a, 4));
+                _mm256_storeu_ps(&dct->b[k], _mm256_i32gather_ps(bcd_levels, 
+                                        _mm256_add_epi32(b, offset), 4));
+                _mm256_storeu_ps(&dct->c[k], _mm256_i32gather_ps(bcd_levels, 
+                                        _mm256_add_epi32(c, offset), 4));
+                _mm256_storeu_ps(&dct->d[k], _mm256_i32gather_ps(bcd_levels, 
+                                        _mm256_add_epi32(d, offset), 4));
+        }
+        unquantize_scalar(quant, n, dct, k);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* ======================================================================
+                        SETUP        
+   ====================================================================== */
+
+/* setup
+ * Purpose: builds the quantization tables and picks the widest kernels 
+ *              this CPU supports, run once
+ */
+static void setup(void)
+{
+        build_tables();
+
+#ifdef HAVE_X86_SIMD
+        __builtin_cpu_init();
+#endif
+        if (!set_kernels("avx2") && !set_kernels("sse2")) {
+                set_kernels("scalar");
+        }
+}
+
+/* set_kernels
+ * Purpose: points the entry points at the named kernels (the SSE2 set 
+ *              quantizes with the scalar kernels)
+ * Parameters: "avx2", "sse2" or "scalar"
+ * Returns: false, changing nothing, if this CPU can not run them
+ */
+static bool set_kernels(const char *name)
+{
+        if (strcmp(name, "scalar") == 0) {
+                forward = forward_scalar;
+                inverse = inverse_scalar;
+                quantize = quantize_scalar;
+                unquantize = unquantize_scalar;
+                kernel_name = "scalar";
+                return true;
+        }
+#ifdef HAVE_X86_SIMD
+        if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+                forward = forward_avx2;
+                inverse = inverse_avx2;
+                quantize = quantize_avx2;
+                unquantize = unquantize_avx2;
+                kernel_name = "avx2";
+                return true;
+        }
+        if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+                forward = forward_sse2;
+                inverse = inverse_sse2;
+                quantize = quantize_scalar;
+                unquantize = unquantize_scalar;
+                kernel_name = "sse2";
+                return true;
+        }
+#endif
+        return false;
+}
+
+/* build_tables
+ * Purpose: fills in the unquantize tables and finds the quantizeBCD 
+ *              thresholds by bisection over the ordered floats in 
+ *              [-BCD_RANGE, BCD_RANGE]. quantizeBCD clamps, scales and 
+ *              rounds, so it never steps down as its input grows.
+ */
+static void build_tables(void)
+{
+        for (int code = 0; code < DCT_BCD_LEVELS; code++) {
+                a_levels[code] = ((float) code) / 63.0;
+                bcd_levels[code] = unquantizeBCD(code - 32);
+        }
+
+        bcd_min = quantizeBCD(-BCD_RANGE);
+        int bcd_max = quantizeBCD(BCD_RANGE);
+        assert(bcd_max >= bcd_min && bcd_max - bcd_min < DCT_BCD_LEVELS);
+
+        for (int j = 0; j < DCT_BCD_LEVELS; j++) {
+                int level = bcd_min + j + 1;
+                if (level > bcd_max) {
+                        bcd_thresholds[j] = INFINITY;
+                        continue;
+                }
+
+                /* smallest float in range that quantizes to level or more */
+                uint32_t low = Floatkey_of(-BCD_RANGE);
+                uint32_t high = Floatkey_of(BCD_RANGE);
+                while (low < high) {
+                        uint32_t mid = low + (high - low) / 2;
+                        if (quantizeBCD(Floatkey_float(mid)) >= level) {
+                                high = mid;
+                        } else {
+                                low = mid + 1;
+                        }
+                }
+                bcd_thresholds[j] = Floatkey_float(low);
+        }
+}
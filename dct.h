@@ -0,0 +1,48 @@
+/*
+ *     dct.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the batched 2x2 DCT kernels used
+ *      by the fused engines. They work on a chunk of up to ROW_CHUNK blocks
+ *      in struct-of-arrays form: forward and inverse DCT, and quantizing 
+ *      and unquantizing the coefficients, several blocks per instruction.
+ *     
+ */ 
+
+#ifndef DCT_H
+#define DCT_H
+
+#include <stdint.h>
+#include "compression.h"
+
+/* b, c and d have 6 bits, so at most 64 levels and 63 thresholds */
+#define DCT_BCD_LEVELS 64
+
+/* DCT_float, one array per field */
+struct DCT_batch {
+        float a[ROW_CHUNK], b[ROW_CHUNK], c[ROW_CHUNK], d[ROW_CHUNK];
+        float avgPb[ROW_CHUNK], avgPr[ROW_CHUNK];
+};
+
+/* DCT_uint, one array per field */
+struct DCT_quant_batch {
+        uint32_t a[ROW_CHUNK], pb[ROW_CHUNK], pr[ROW_CHUNK];
+        int32_t b[ROW_CHUNK], c[ROW_CHUNK], d[ROW_CHUNK];
+};
+
+void Dct_forward_batch(const struct pixel_chunk *chunk, int n, 
+                       struct DCT_batch *dct);
+void Dct_inverse_batch(const struct DCT_batch *dct, int n, 
+                       struct pixel_chunk *chunk);
+void Dct_quantize_batch(const struct DCT_batch *dct, int n, 
+                        struct DCT_quant_batch *quant);
+void Dct_unquantize_batch(const struct DCT_quant_batch *quant, int n, 
+                          struct DCT_batch *dct);
+
+/* name of the kernels in use: "avx2", "sse2" or "scalar" */
+const char *Dct_kernel(void);
+bool Dct_use_kernel(const char *name);
+int Dct_bcd_thresholds(float *thresholds, int *lowest);
+
+#endif
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 #include "pnm.h"
 #include "assert.h"
 #include "a2methods.h"
@@ -20,8 +21,21 @@
 #include "a2blocked.h"
 #include "compression.h"
 #include "mem.h"
-#include "arith40.h"
 #include "bitpack.h"
+#include "parallel.h"
+#include "colorspace.h"
+#include "dct.h"
+#include "chroma.h"
+#include "codeword.h"
+#include "a2spans.h"
+#include "stages.h"
+#include "stats.h"
+#include "except.h"
+#include <sys/stat.h>
+
+Except_T Compressed_Truncated = { "Compressed image is truncated" };
+
+static unsigned read_compressed_number(FILE *fp, int after);
 
 /* decompressedImage
  * Purpose: decompression driver function: takes in a regular image and carries
@@ -34,8 +48,11 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
 
         A2Methods_T methods_plain = uarray2_methods_plain;
         A2Methods_T methods_blocked = uarray2_methods_blocked;
-        A2Methods_mapfun *mapRow = methods_plain->map_default;
-        A2Methods_mapfun *mapBlocked = methods_blocked->map_default;
+        A2Methods_spanmapfun *mapRows = uarray2_spans_plain->map_rows;
+        /* the per cell steps below run on the Parallel_map_bands threads */
+        A2Methods_mapfun *mapParallel = uarray2_spans_plain->map_parallel;
+        A2Methods_mapfun *mapParallelBlocked = 
+                                        uarray2_spans_blocked->map_parallel;
 
         int width = methods_plain->width(codewords_uarray2);
         int height = methods_plain->height(codewords_uarray2);
@@ -45,14 +62,16 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
         A2Methods_UArray2 DCTInt_decompressed = methods_plain->new(width, 
                                         height, sizeof(struct DCT_uint));      
         assert(DCTInt_decompressed != NULL);
-        mapRow(DCTInt_decompressed, unpack_codeword, source_cl);
+        mapParallel(DCTInt_decompressed, unpack_codeword, source_cl);
+        Stages_mark("unpack_codeword");
         
                         /*DECOMPRESS STEP 4: DCTInt --> Float*/
         A2Methods_UArray2 DCTFloat_decompressed = methods_plain->new(width, 
                                         height, sizeof(struct DCT_float));
         assert(DCTFloat_decompressed != NULL);
         source_cl->array2 = DCTInt_decompressed;
-        mapRow(DCTFloat_decompressed, DCTint_to_float, source_cl);
+        mapParallel(DCTFloat_decompressed, DCTint_to_float, source_cl);
+        Stages_mark("dct_int_to_float");
 
         /* from now on, our uarray2 is storing single cells as 2x2 blocks, 
          * so we must update the overall width and height variables to account 
@@ -67,7 +86,9 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
                                                 sizeof(struct compVid), 2);
         assert(compVids_blocked_decompressed != NULL);
         source_cl->array2 = DCTFloat_decompressed;
-        mapBlocked(compVids_blocked_decompressed, DCT_to_compVid, source_cl);
+        mapParallelBlocked(compVids_blocked_decompressed, DCT_to_compVid, 
+                           source_cl);
+        Stages_mark("dct_to_compvid");
 
                         /*DECOMPRESS STEP 2.5: blocked -> plain */
         A2Methods_UArray2 compVids_plain_decomp = methods_plain->new(width, 
@@ -75,7 +96,8 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
         assert(compVids_plain_decomp != NULL);
         source_cl->array2 = compVids_blocked_decompressed;
         source_cl->methods = methods_blocked;
-        mapRow(compVids_plain_decomp, blocked_to_plain, source_cl);
+        mapParallel(compVids_plain_decomp, blocked_to_plain, source_cl);
+        Stages_mark("blocked_to_plain");
         
                         /*DECOMPRESS STEP 2: compvids -> RGB floats*/
         source_cl->array2 = compVids_plain_decomp;
@@ -83,14 +105,16 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
         A2Methods_UArray2 RGBFloat_decomp = methods_plain->new(width, height, 
                                                 sizeof(struct rgbFloat));
         assert(RGBFloat_decomp != NULL);
-        mapRow(RGBFloat_decomp, compVid_to_RGBFloat, source_cl);
+        mapRows(RGBFloat_decomp, compVid_to_RGBFloat, source_cl);
+        Stages_mark("compvid_to_rgb_float");
                 
                         /*DECOMPRESS STEP 1: RGB float -> Int*/
         source_cl->array2 = RGBFloat_decomp;
         A2Methods_UArray2 RGBInt_decomp = methods_plain->new(width, height, 
                                                     sizeof(struct Pnm_rgb));
         assert(RGBInt_decomp != NULL);
-        mapRow(RGBInt_decomp, RGB_float_to_int, source_cl);
+        mapRows(RGBInt_decomp, RGB_float_to_int, source_cl);
+        Stages_mark("rgb_float_to_int");
 
         methods_plain->free(&DCTInt_decompressed);
         methods_plain->free(&DCTFloat_decompressed);
@@ -105,68 +129,65 @@ A2Methods_UArray2 decompressedImage(A2Methods_UArray2 codewords_uarray2)
 
 
 /* RGB_float_to_int
- * Purpose: Converts a uarray of RGBfloat structs to a UArray of RGBint structs
- * Parameters: 
+ * Purpose: decompression span apply function that converts a run of 
+ *              RGBfloat structs to RGBint structs, a whole row at a time
+ * Parameters: first column, row and length of the run, destination run, 
+ *              destination array, plain_cl closure holding the source array
  * Returns: N/A
  */
-void RGB_float_to_int(int col, int row, A2Methods_UArray2 end_array, 
-                      void *elem, void *cl) 
+void RGB_float_to_int(int col, int row, int length, void *elems, 
+                      A2Methods_UArray2 end_array, void *cl) 
 {
         (void) end_array;
         
         /* unpack the closure */
         struct plain_cl *start = cl;
-        A2Methods_T methods = start->methods;
-        A2Methods_UArray2 start_array = start->array2; 
         
-        rgbFloat currFloat = methods->at(start_array, col, row);
-        int r = (int) (currFloat->red * 255);
-        int g = (int) (currFloat->green * 255);
-        int b = (int) (currFloat->blue * 255);
-        
-        r = squash_into_range(0, 255, r);
-        g = squash_into_range(0, 255, g);
-        b = squash_into_range(0, 255, b);
-
-        struct Pnm_rgb *currInt;
-        currInt = (Pnm_rgb) elem;
-        
-        currInt->red = r;
-        currInt->green = g;
-        currInt->blue = b;
+        const struct rgbFloat *currFloat = A2Methods_span_at(start->methods,
+                                        start->array2, col, row, length);
+        struct Pnm_rgb *currInt = elems;
+
+        for (int i = 0; i < length; i++) {
+                int r = (int) (currFloat[i].red * 255);
+                int g = (int) (currFloat[i].green * 255);
+                int b = (int) (currFloat[i].blue * 255);
+
+                currInt[i].red = squash_into_range(0, 255, r);
+                currInt[i].green = squash_into_range(0, 255, g);
+                currInt[i].blue = squash_into_range(0, 255, b);
+        }
 }
  
 /* compVid_to_RGBFloat
- * Purpose: Apply function to be called via map that carries out the step of
- *               decompression that converts compvid structs to RGB floats
- * Parameters: 
+ * Purpose: span apply function to be called via map_rows that carries out
+ *               the step of decompression that converts compvid structs to
+ *               RGB floats
+ * Parameters: first column, row and length of the run, destination run, 
+ *              destination array, plain_cl closure holding the source array
  * Returns: N/A
  */
-void compVid_to_RGBFloat(int col, int row, A2Methods_UArray2 end_array, 
-                         void *elem, void *cl)
+void compVid_to_RGBFloat(int col, int row, int length, void *elems, 
+                         A2Methods_UArray2 end_array, void *cl)
 {
         (void) end_array;
 
          /* unpack the closure */
         struct plain_cl *start = cl;
-        A2Methods_T methods = start->methods;
-        A2Methods_UArray2 start_array = start->array2; 
         
-        compVid currCompVid = methods->at(start_array, col, row);
-        float y = currCompVid->y;
-        float pb = currCompVid->pb;
-        float pr = currCompVid->pr;
-
-        float r = 1.0 * y + 0.0 * pb + 1.402 * pr;
-        float g = 1.0 * y - 0.344136 * pb - 0.714136 * pr;
-        float b = 1.0 * y + 1.772 * pb + 0.0 * pr;
-
-        struct rgbFloat *currElem;
-        currElem = (rgbFloat) elem;
-
-        currElem->red = r;
-        currElem->green = g;
-        currElem->blue = b;
+        const struct compVid *currCompVid = A2Methods_span_at(
+                                        start->methods, start->array2, col,
+                                        row, length);
+        struct rgbFloat *currElem = elems;
+
+        for (int i = 0; i < length; i++) {
+                float y = currCompVid[i].y;
+                float pb = currCompVid[i].pb;
+                float pr = currCompVid[i].pr;
+
+                currElem[i].red = 1.0 * y + 0.0 * pb + 1.402 * pr;
+                currElem[i].green = 1.0 * y - 0.344136 * pb - 0.714136 * pr;
+                currElem[i].blue = 1.0 * y + 1.772 * pb + 0.0 * pr;
+        }
 }
 
 /* blocked_to_plain
@@ -215,11 +236,39 @@ void DCT_to_compVid(int col, int row, A2Methods_UArray2 dest_array,
         destCompVid = (compVid) elem;
         
         DCT_float currDCT = methods->at(start_array, col / 2, row / 2);
-        compVid tempCompVid = createCompVid(currDCT, col, row);
-
-        *destCompVid = *tempCompVid;
+        setCompVid(currDCT, col, row, destCompVid);
+}
 
-        FREE(tempCompVid);
+/* setCompVid
+ * Purpose: computes one pixel of a block from its DCT straight into the 
+ *              caller's storage, without a heap allocation per pixel
+ * Parameters: DCT of the block, column and row of the pixel in the image,
+ *              destination compVid
+ * Returns: N/A
+ */
+void setCompVid(DCT_float currDCT, int col, int row, compVid dest)
+{
+        assert(currDCT != NULL && dest != NULL);
+        float a = currDCT->a;
+        float b = currDCT->b;
+        float c = currDCT->c;
+        float d = currDCT->d;
+
+        dest->pb = currDCT->avgPb;
+        dest->pr = currDCT->avgPr;
+
+        if (row % 2 == 0 && col % 2 == 0) {
+                dest->y = a - b - c + d;
+        }
+        else if (row % 2 == 0 && col % 2 != 0) {
+                dest->y = a - b + c - d;
+        }
+        else if (row % 2 != 0 && col % 2 == 0) {
+                dest->y = a + b - c - d;
+        }
+        else {
+                dest->y = a + b + c + d;
+        }
 }
 
 /* DCTint_to_Float
@@ -251,8 +300,8 @@ void DCT_to_compVid(int col, int row, A2Methods_UArray2 dest_array,
         destDCTFloat->c = unquantizeBCD(currDCTuInt->c);
         destDCTFloat->d = unquantizeBCD(currDCTuInt->d);
 
-        destDCTFloat->avgPb = Arith40_chroma_of_index(currDCTuInt->pb);
-        destDCTFloat->avgPr = Arith40_chroma_of_index(currDCTuInt->pr); 
+        destDCTFloat->avgPb = Chroma_of_index(currDCTuInt->pb);
+        destDCTFloat->avgPr = Chroma_of_index(currDCTuInt->pr);
 }
 
 /* unpack_codeword
@@ -280,46 +329,209 @@ void unpack_codeword(int col, int row, A2Methods_UArray2 dest_array,
         uint32_t *currCodeword = methods->at(start_array, col, row);
         
         /* unpack everything from the codeword */ 
-        destDCT->a = Bitpack_getu(*currCodeword, 6, 26);
-        destDCT->b = Bitpack_gets(*currCodeword, 6, 20);
-        destDCT->c = Bitpack_gets(*currCodeword, 6, 14);
-        destDCT->d = Bitpack_gets(*currCodeword, 6, 8);
-        destDCT->pb = Bitpack_getu(*currCodeword, 4, 4);
-        destDCT->pr = Bitpack_getu(*currCodeword, 4, 0);
+        destDCT->a = Codeword_a(*currCodeword);
+        destDCT->b = Codeword_b(*currCodeword);
+        destDCT->c = Codeword_c(*currCodeword);
+        destDCT->d = Codeword_d(*currCodeword);
+        destDCT->pb = Codeword_pb(*currCodeword);
+        destDCT->pr = Codeword_pr(*currCodeword);
 }
 
 /* read_compressed
  * Purpose: read in from a file to make a uarray of uint32-ts
  *          the header, save the width and height, and make a new UArray2
- *          of width x height to store uint 32s and map onto it 
- * Parameters: 
- * Returns: N/A
+ *          of width x height to store uint 32s and fill it in. When the 
+ *          input is a regular file its size is checked against the header
+ *          before anything is allocated; the codewords are then read in
+ *          chunks of about INPUT_BUFFER bytes and byte swapped in bulk 
+ *          (read_a_codeword is the one codeword at a time reference)
+ * Parameters: file to read from
+ * Returns: UArray2 of codewords
+ * Raises: Compressed_Truncated if the file ends before the last codeword
  */
 UArray2_T read_compressed(FILE *fp)
 {
         unsigned height, width;
 
         /* read in header */
-        int read = fscanf(fp, "COMP40 Compressed image format 2\n%u %u", 
-                                                        &width, &height);
-        assert(read == 2);
-        int c = getc(fp);
-        assert(c == '\n');
+        read_compressed_header(fp, &width, &height);
+        check_compressed_size(fp, width, height);
         
         A2Methods_UArray2 codewords_uarray2 = uarray2_methods_plain->new(width,
                                                      height, sizeof(uint32_t));
         
         /* read codewords from file and store in codewords_uarray2 */
-        uarray2_methods_plain->map_row_major(codewords_uarray2,
-                                             read_a_codeword, fp);
+        read_codewords(fp, codewords_uarray2, uarray2_methods_plain);
 
         return codewords_uarray2;
 }
 
+/* read_compressed_header
+ * Purpose: parses the header of a compressed image, leaving fp at the 
+ *              first codeword
+ * Parameters: file to read from, destination width and height (in 
+ *              codewords), each at most INT_MAX / 2
+ * Returns: N/A
+ * Raises: Compressed_Truncated if the file ends inside the header
+ */
+void read_compressed_header(FILE *fp, unsigned *width, unsigned *height)
+{
+        static const char magic[] = "COMP40 Compressed image format 2\n";
+
+        for (int i = 0; magic[i] != '\0'; i++) {
+                int c = getc(fp);
+                if (c == EOF) {
+                        RAISE(Compressed_Truncated);
+                }
+                assert(c == magic[i]);
+        }
+        Stats_count_read(sizeof(magic) - 1);
+
+        *width = read_compressed_number(fp, ' ');
+        *height = read_compressed_number(fp, '\n');
+
+        /* the decompressors double both, as ints, for the size in pixels */
+        assert(*width <= INT_MAX / 2 && *height <= INT_MAX / 2);
+}
+
+/* read_compressed_number
+ * Purpose: reads one decimal number of the header and the character that
+ *              has to follow it
+ * Parameters: file to read from, expected character after the number
+ * Returns: the number read
+ */
+static unsigned read_compressed_number(FILE *fp, int after)
+{
+        uint64_t number = 0;
+        int digits = 0;
+        int c = getc(fp);
+
+        while (c >= '0' && c <= '9') {
+                number = number * 10 + (c - '0');
+                assert(number <= UINT32_MAX);
+                digits++;
+                c = getc(fp);
+        }
+        if (c == EOF) {
+                RAISE(Compressed_Truncated);
+        }
+        assert(digits > 0 && c == after);
+        Stats_count_read(digits + 1);
+
+        return (unsigned) number;
+}
+
+/* check_compressed_size
+ * Purpose: if fp is a regular file, checks that what is left of it holds
+ *              all width * height codewords. Pipes can not be measured, so
+ *              they are checked as they are read.
+ * Parameters: file positioned at the first codeword, width and height in 
+ *              codewords
+ * Returns: N/A
+ * Raises: Compressed_Truncated if the file is too short
+ */
+void check_compressed_size(FILE *fp, unsigned width, unsigned height)
+{
+        struct stat info;
+        if (fstat(fileno(fp), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return;
+        }
+
+        long position = ftell(fp);
+        if (position < 0) {
+                return;
+        }
+
+        uint64_t needed = 4 * (uint64_t) width * height;
+        if (info.st_size < position || 
+            (uint64_t) (info.st_size - position) < needed) {
+                RAISE(Compressed_Truncated);
+        }
+}
+
+/* read_codewords
+ * Purpose: reads width * height big endian codewords into a UArray2, as 
+ *              many whole rows at a time as fit in INPUT_BUFFER bytes: one
+ *              fread, one bulk byte swap, then the rows are copied in
+ * Parameters: file positioned at the first codeword, destination array, 
+ *              methods to use on it
+ * Returns: N/A
+ * Raises: Compressed_Truncated if the file ends before the last codeword
+ */
+void read_codewords(FILE *fp, A2Methods_UArray2 codewords, 
+                    A2Methods_T methods)
+{
+        int width = methods->width(codewords);
+        int height = methods->height(codewords);
+        if (width == 0 || height == 0) {
+                return;
+        }
+
+        int rowsPerBuffer = INPUT_BUFFER / (width * 4);
+        if (rowsPerBuffer < 1) {
+                rowsPerBuffer = 1;
+        }
+        if (rowsPerBuffer > height) {
+                rowsPerBuffer = height;
+        }
+        uint32_t *buffer = ALLOC((long) rowsPerBuffer * width * 
+                                 sizeof(uint32_t));
+
+        for (int firstRow = 0; firstRow < height; firstRow += rowsPerBuffer) {
+                int rows = (height - firstRow < rowsPerBuffer) ? 
+                                        height - firstRow : rowsPerBuffer;
+                long count = (long) rows * width;
+
+                if (fread(buffer, 4, count, fp) != (size_t) count) {
+                        FREE(buffer);
+                        RAISE(Compressed_Truncated);
+                }
+                Stats_count_read(4 * count);
+
+                /* swapped in place, the buffer now holds the codewords */
+                Codeword_from_bigendian((unsigned char *) buffer, count, 
+                                        buffer);
+                for (int row = 0; row < rows; row++) {
+                        uint32_t *src = &buffer[(long) row * width];
+                        for (int col = 0; col < width; col++) {
+                                *(uint32_t *) methods->at(codewords, col, 
+                                                firstRow + row) = src[col];
+                        }
+                }
+        }
+
+        FREE(buffer);
+}
+
+/* read_codeword_bytes
+ * Purpose: reads every codeword of a compressed image, left as the big 
+ *              endian bytes of the format, with a single fread; the bytes
+ *              are unpacked directly by fusedDecompressedRaw
+ * Parameters: file positioned after the header, width and height in 
+ *              codewords
+ * Returns: buffer of 4 * width * height bytes, freed by the caller
+ * Raises: Compressed_Truncated if the file ends first
+ */
+unsigned char *read_codeword_bytes(FILE *fp, unsigned width, 
+                                   unsigned height)
+{
+        size_t count = (size_t) width * height;
+        unsigned char *bytes = ALLOC(count * 4 + 1);
+
+        if (fread(bytes, 4, count, fp) != count) {
+                FREE(bytes);
+                RAISE(Compressed_Truncated);
+        }
+        Stats_count_read(4 * count);
+
+        return bytes;
+}
+
 /* read_a_codeword
  * Purpose: Apply function that reads in 4 chars from a file at a time and 
  *              stores them in a uint32_t to be stored in a uarray2 of
- *              codewords
+ *              codewords. Kept as the reference for read_codewords, which 
+ *              reads the same codewords in bulk.
  * Parameters: 
  * Returns: N/A
  */
@@ -377,4 +589,284 @@ void print_decompressed(A2Methods_UArray2 rgb_decomp_uarray2)
         Pnm_ppmwrite(stdout, image);
 
         Pnm_ppmfree(&image);
-}
\ No newline at end of file
+}
+
+/* write_decompressed
+ * Purpose: decompresses big endian codeword bytes into one contiguous raw
+ *              raster and writes it as a PPM with one fwrite, without the 
+ *              UArray2 of Pnm_rgb structs print_decompressed needs. The 
+ *              output is identical.
+ * Parameters: width * height codewords (4 bytes each), width and height in
+ *              codewords (at most INT_MAX / 2, so that doubled they are 
+ *              still ints), file to write to
+ * Returns: N/A
+ */
+void write_decompressed(const unsigned char *bytes, unsigned width, 
+                        unsigned height, FILE *output)
+{
+        assert(width <= INT_MAX / 2 && height <= INT_MAX / 2);
+        unsigned pixelWidth = width * 2;
+        unsigned pixelHeight = height * 2;
+        unsigned char *raster = ALLOC((size_t) pixelWidth * pixelHeight * 3
+                                      + 1);
+
+        fusedDecompressedRaw(bytes, (int) width, (int) height, raster);
+        Stats_count_blocks((uint64_t) width * height);
+        Stages_mark("decompress");
+
+        Rawppm_write_header(output, pixelWidth, pixelHeight);
+        Rawppm_write_rows(output, raster, pixelWidth, pixelHeight);
+        Stages_mark("write");
+
+        FREE(raster);
+}
+
+/* ======================================================================
+                        FUSED DECOMPRESSION ENGINE        
+   ====================================================================== */
+
+struct decompress_band_cl {
+        A2Methods_UArray2 codewords;
+        A2Methods_UArray2 pixels;
+};
+
+/* big endian codeword bytes and destination raster of fusedDecompressedRaw */
+struct decompress_raw_cl {
+        const unsigned char *bytes;
+        unsigned char *raster;
+        int width;
+};
+
+static void decompress_band(int firstRow, int lastRow, void *cl);
+static void decompress_raw_band(int firstRow, int lastRow, void *cl);
+static void store_chunk(struct pixel_chunk *chunk, int blocks, 
+                        A2Methods_UArray2 pixels, int start, int blockRow);
+static void decode_chunk(const struct DCT_quant_batch *quant, int blocks, 
+                         struct pixel_chunk *chunk);
+static inline void store_pixel(struct pixel_chunk *chunk, int i, 
+                               Pnm_rgb pixel);
+static inline void store_raw_pixel(struct pixel_chunk *chunk, int i, 
+                                   unsigned char *px);
+
+/* fusedDecompressedImage
+ * Purpose: single pass decompression driver: turns each codeword into its
+ *          four output pixels in one step and writes them straight into the
+ *          output raster, skipping the intermediate arrays built by
+ *          decompressedImage. Produces the exact same pixels. Rows of
+ *          codewords are spread over Parallel_threads() threads.
+ * Parameters: UArray2 of codewords
+ * Returns: Decompressed Image as a UArray2 of Pnm_rgb structs
+ */
+A2Methods_UArray2 fusedDecompressedImage(A2Methods_UArray2 codewords_uarray2)
+{
+        A2Methods_T methods_plain = uarray2_methods_plain;
+
+        int width = methods_plain->width(codewords_uarray2);
+        int height = methods_plain->height(codewords_uarray2);
+
+        A2Methods_UArray2 RGBInt_decomp = methods_plain->new(width * 2, 
+                                   height * 2, sizeof(struct Pnm_rgb));
+        assert(RGBInt_decomp != NULL);
+
+        /* every codeword row decodes on its own, so reconstruct the pixels
+         * in bands, in parallel if more than one thread was requested
+         */
+        struct decompress_band_cl band_cl = { codewords_uarray2, 
+                                              RGBInt_decomp };
+        Parallel_map_bands(height, decompress_band, &band_cl);
+
+        return RGBInt_decomp;
+}
+
+/* fusedDecompressedRaw
+ * Purpose: fusedDecompressedImage straight from the big endian bytes of 
+ *          the compressed format (such as a mapped file) into a contiguous
+ *          raw PPM raster, without a UArray2 on either side. Produces the
+ *          exact same pixels.
+ * Parameters: width * height codewords (4 bytes each), width and height in
+ *          codewords, destination raster of 2 * height rows of 
+ *          2 * width pixels (3 bytes each)
+ * Returns: N/A
+ */
+void fusedDecompressedRaw(const unsigned char *bytes, int width, int height,
+                          unsigned char *raster)
+{
+        assert(bytes != NULL || width == 0 || height == 0);
+        assert(raster != NULL || width == 0 || height == 0);
+
+        struct decompress_raw_cl band_cl = { bytes, raster, width };
+        Parallel_map_bands(height, decompress_raw_band, &band_cl);
+}
+
+/* decompress_band
+ * Purpose: band apply function that decompresses rows of codewords 
+ *              [firstRow, lastRow), possibly on its own thread
+ * Parameters: band of codeword rows, decompress_band_cl closure
+ * Returns: N/A
+ */
+static void decompress_band(int firstRow, int lastRow, void *cl)
+{
+        struct decompress_band_cl *band_cl = cl;
+
+        for (int row = firstRow; row < lastRow; row++) {
+                decompress_block_row(band_cl->codewords, band_cl->pixels, 
+                                                                        row);
+        }
+}
+
+/* decompress_raw_band
+ * Purpose: band apply function that decompresses rows of codeword bytes 
+ *              [firstRow, lastRow) into a raw raster, possibly on its own
+ *              thread
+ * Parameters: band of codeword rows, decompress_raw_cl closure
+ * Returns: N/A
+ */
+static void decompress_raw_band(int firstRow, int lastRow, void *cl)
+{
+        struct decompress_raw_cl *band_cl = cl;
+        size_t rowBytes = (size_t) band_cl->width * 2 * 3;
+
+        for (int row = firstRow; row < lastRow; row++) {
+                unsigned char *top = band_cl->raster + 
+                                     (size_t) row * 2 * rowBytes;
+                decompress_raw_row(band_cl->bytes + 
+                                        (size_t) row * band_cl->width * 4, 
+                                   band_cl->width, top, top + rowBytes);
+        }
+}
+
+/* decompress_block_row
+ * Purpose: decompresses one row of codewords into the matching two rows of
+ *              pixels in the output raster, ROW_CHUNK blocks at a time 
+ *              through the color row kernels
+ * Parameters: source codeword array, destination pixel array, row of blocks
+ * Returns: N/A
+ */
+void decompress_block_row(A2Methods_UArray2 codewords, 
+                          A2Methods_UArray2 pixels, int blockRow)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        int width = methods->width(codewords);
+
+        struct pixel_chunk chunk;
+        struct DCT_quant_batch quant;
+        uint32_t chunkWords[ROW_CHUNK];
+
+        for (int start = 0; start < width; start += ROW_CHUNK) {
+                int blocks = (width - start < ROW_CHUNK) ? width - start 
+                                                         : ROW_CHUNK;
+                for (int k = 0; k < blocks; k++) {
+                        chunkWords[k] = *(uint32_t *) methods->at(codewords, 
+                                                    start + k, blockRow);
+                }
+                Codeword_unpack_batch(chunkWords, blocks, &quant);
+                decode_chunk(&quant, blocks, &chunk);
+                store_chunk(&chunk, blocks, pixels, start, blockRow);
+        }
+}
+
+/* store_chunk
+ * Purpose: stores a decoded chunk into its two rows of the output raster
+ * Parameters: decoded chunk, number of blocks in it, destination pixel 
+ *              array, column of its first block, row of blocks
+ * Returns: N/A
+ */
+static void store_chunk(struct pixel_chunk *chunk, int blocks, 
+                        A2Methods_UArray2 pixels, int start, int blockRow)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        int top = blockRow * 2;
+
+        for (int k = 0; k < blocks; k++) {
+                int left = (start + k) * 2;
+                store_pixel(chunk, k, methods->at(pixels, left, top));
+                store_pixel(chunk, blocks + k, 
+                            methods->at(pixels, left + 1, top));
+                store_pixel(chunk, 2 * blocks + k, 
+                            methods->at(pixels, left, top + 1));
+                store_pixel(chunk, 3 * blocks + k, 
+                            methods->at(pixels, left + 1, top + 1));
+        }
+}
+
+/* decompress_raw_row
+ * Purpose: decompresses one row of codewords, stored as the big endian 
+ *              bytes of the compressed format, into two rows of a raw PPM
+ *              raster (denominator 255), ROW_CHUNK blocks at a time
+ * Parameters: row of codewords (4 * width bytes), number of codewords, 
+ *              destination top and bottom raster rows (2 * width pixels of
+ *              3 bytes each)
+ * Returns: N/A
+ */
+void decompress_raw_row(const unsigned char *bytes, int width, 
+                        unsigned char *top, unsigned char *bottom)
+{
+        struct pixel_chunk chunk;
+        struct DCT_quant_batch quant;
+
+        for (int start = 0; start < width; start += ROW_CHUNK) {
+                int blocks = (width - start < ROW_CHUNK) ? width - start 
+                                                         : ROW_CHUNK;
+                Codeword_unpack_batch_be(&bytes[start * 4], blocks, &quant);
+                decode_chunk(&quant, blocks, &chunk);
+
+                unsigned char *topRow = &top[start * 6];
+                unsigned char *bottomRow = &bottom[start * 6];
+                for (int k = 0; k < blocks; k++) {
+                        store_raw_pixel(&chunk, k, &topRow[6 * k]);
+                        store_raw_pixel(&chunk, blocks + k, 
+                                        &topRow[6 * k + 3]);
+                        store_raw_pixel(&chunk, 2 * blocks + k, 
+                                        &bottomRow[6 * k]);
+                        store_raw_pixel(&chunk, 3 * blocks + k, 
+                                        &bottomRow[6 * k + 3]);
+                }
+        }
+}
+
+/* decode_chunk
+ * Purpose: runs the batched unquantizer and inverse DCT over a chunk of 
+ *              blocks the caller unpacked with one bulk Codeword call, then
+ *              converts the whole chunk to RGB floats with one call to the
+ *              row kernel
+ * Parameters: quantized blocks, number of blocks, chunk to fill in
+ * Returns: N/A
+ */
+static void decode_chunk(const struct DCT_quant_batch *quant, int blocks, 
+                         struct pixel_chunk *chunk)
+{
+        struct DCT_batch dct;
+
+        Dct_unquantize_batch(quant, blocks, &dct);
+        Dct_inverse_batch(&dct, blocks, chunk);
+        Colorspace_ypbpr_to_rgb(chunk->y, chunk->pb, chunk->pr, 
+                                chunk->r, chunk->g, chunk->b, 4 * blocks);
+}
+
+/* store_pixel
+ * Purpose: stores one RGB float pixel of a chunk as a scaled integer pixel 
+ *              with denominator 255, see RGB_float_to_int
+ * Parameters: chunk, index in the chunk, destination pixel
+ * Returns: N/A
+ */
+static inline void store_pixel(struct pixel_chunk *chunk, int i, 
+                               Pnm_rgb pixel)
+{
+        pixel->red = squash_into_range(0, 255, (int) (chunk->r[i] * 255));
+        pixel->green = squash_into_range(0, 255, (int) (chunk->g[i] * 255));
+        pixel->blue = squash_into_range(0, 255, (int) (chunk->b[i] * 255));
+}
+
+/* store_raw_pixel
+ * Purpose: store_pixel for an 8 bit raw pixel
+ * Parameters: decoded chunk, index in the chunk, destination of 3 samples
+ * Returns: N/A
+ */
+static inline void store_raw_pixel(struct pixel_chunk *chunk, int i, 
+                                   unsigned char *px)
+{
+        px[0] = squash_into_range(0, 255, (int) (chunk->r[i] * 255));
+        px[1] = squash_into_range(0, 255, (int) (chunk->g[i] * 255));
+        px[2] = squash_into_range(0, 255, (int) (chunk->b[i] * 255));
+}
+
@@ -0,0 +1,143 @@
+/*
+ *     decompressBench.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains a benchmark for the band-parallel decompressor. 
+ *      It compresses the given image once, then times fusedDecompressedImage
+ *      with 1, 2, 4, 8, 16 and 32 threads and reports the speedup over a 
+ *      single thread.
+ *
+ *     It also counts heap allocations, the ones made through mem.h as
+ *      counted by memtrack (see memtrack.h). Every pipeline is run once
+ *      more and its allocations are reported per 2x2 block; a pipeline that
+ *      allocates per block shows 1 or more, one that only allocates its
+ *      arrays shows close to 0.
+ *
+ *     Usage: decompress_bench image.ppm [repetitions]
+ *     
+ */ 
+
+#include "compression.h"
+#include "parallel.h"
+#include "memtrack.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <mem.h>
+
+#define MAX_THREADS 32
+
+void report_allocations(Pnm_ppm sourceImage, A2Methods_UArray2 codewords);
+void print_allocations(const char *pipeline, uint64_t count, double blocks);
+
+int main(int argc, char *argv[])
+{
+        if (argc < 2 || argc > 3) {
+                fprintf(stderr, "Usage: %s image.ppm [repetitions]\n", 
+                                                                argv[0]);
+                exit(EXIT_FAILURE);
+        }
+        int reps = (argc == 3) ? atoi(argv[2]) : 5;
+        assert(reps >= 1);
+
+        FILE *filep = fopen(argv[1], "r");
+        assert(filep != NULL);
+        Pnm_ppm sourceImage = Pnm_ppmread(filep, uarray2_methods_plain);
+        fclose(filep);
+
+        A2Methods_UArray2 codewords = fusedCompressedImage(sourceImage);
+        double megapixels = 4.0 * uarray2_methods_plain->width(codewords) * 
+                            uarray2_methods_plain->height(codewords) / 1e6;
+        double serial = 0.0;
+
+        printf("threads,seconds,megapixels_per_second,speedup\n");
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+                Parallel_set_threads(threads);
+
+                /* keep the best of reps runs */
+                double best = -1.0;
+                for (int i = 0; i < reps; i++) {
+                        double start = Timing_seconds(CLOCK_MONOTONIC);
+                        A2Methods_UArray2 pixels = 
+                                        fusedDecompressedImage(codewords);
+                        double seconds = Timing_seconds(CLOCK_MONOTONIC) -
+                                         start;
+                        uarray2_methods_plain->free(&pixels);
+
+                        if (best < 0 || seconds < best) {
+                                best = seconds;
+                        }
+                }
+                if (threads == 1) {
+                        serial = best;
+                }
+                printf("%d,%.6f,%.2f,%.2f\n", threads, best, 
+                       megapixels / best, serial / best);
+        }
+
+        report_allocations(sourceImage, codewords);
+
+        uarray2_methods_plain->free(&codewords);
+        Pnm_ppmfree(&sourceImage);
+
+        return 0;
+}
+
+/* report_allocations
+ * Purpose: runs every compression and decompression pipeline once on one
+ *              thread and prints how many heap allocations each made, in
+ *              total and per 2x2 block
+ * Parameters: source image, its codewords
+ * Returns: N/A
+ */
+void report_allocations(Pnm_ppm sourceImage, A2Methods_UArray2 codewords)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        double blocks = (double) methods->width(codewords) * 
+                        methods->height(codewords);
+        A2Methods_UArray2 result;
+        uint64_t before;
+
+        Parallel_set_threads(1);
+        printf("\npipeline,allocations,allocations_per_block\n");
+
+        before = Memtrack_allocations();
+        result = compressedImage(sourceImage);
+        print_allocations("staged_compress", 
+                Memtrack_allocations() - before, 
+                blocks);
+        methods->free(&result);
+
+        before = Memtrack_allocations();
+        result = fusedCompressedImage(sourceImage);
+        print_allocations("fused_compress", 
+                Memtrack_allocations() - before, 
+                blocks);
+        methods->free(&result);
+
+        before = Memtrack_allocations();
+        result = decompressedImage(codewords);
+        print_allocations("staged_decompress", 
+                Memtrack_allocations() - before, 
+                blocks);
+        methods->free(&result);
+
+        before = Memtrack_allocations();
+        result = fusedDecompressedImage(codewords);
+        print_allocations("fused_decompress", 
+                Memtrack_allocations() - before, 
+                blocks);
+        methods->free(&result);
+}
+
+/* print_allocations
+ * Purpose: prints one line of the allocation report
+ * Parameters: pipeline name, allocations it made, number of blocks
+ * Returns: N/A
+ */
+void print_allocations(const char *pipeline, uint64_t count, double blocks)
+{
+        printf("%s,%lu,%.4f\n", pipeline, (unsigned long) count, 
+               count / blocks);
+}
@@ -0,0 +1,80 @@
+/*
+ *     fastbitpack.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains unchecked, static inline versions of the Bitpack
+ *      getters and setters, for fields whose width, lsb and value are 
+ *      already known to be good (such as the fixed codeword layout in 
+ *      codeword.h). With constant widths and lsbs each call compiles down
+ *      to a shift and a mask. 
+ *
+ *     Nothing is checked: width must be in [1, 64], width + lsb must be at
+ *      most 64, and values that do not fit are cut down to width bits 
+ *      instead of raising Bitpack_Overflow. Anything built from untrusted
+ *      input should go through the checked Bitpack_* functions instead.
+ *     
+ */ 
+
+#ifndef FASTBITPACK_H
+#define FASTBITPACK_H
+
+#include <stdint.h>
+
+/* Bitpack_mask_fast
+ * Purpose: width ones in the low bits of a word
+ */
+static inline uint64_t Bitpack_mask_fast(unsigned width)
+{
+        return ~(uint64_t) 0 >> (64 - width);
+}
+
+/* Bitpack_getu_fast
+ * Purpose: unchecked Bitpack_getu
+ * Parameters: word, width and lsb of the field
+ * Returns: the field as an unsigned value
+ */
+static inline uint64_t Bitpack_getu_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb)
+{
+        return (word >> lsb) & Bitpack_mask_fast(width);
+}
+
+/* Bitpack_gets_fast
+ * Purpose: unchecked Bitpack_gets, shifts the field to the top of the word
+ *              then arithmetic shifts it back down to sign extend it
+ * Parameters: word, width and lsb of the field
+ * Returns: the field as a signed value
+ */
+static inline int64_t Bitpack_gets_fast(uint64_t word, unsigned width, 
+                                        unsigned lsb)
+{
+        return (int64_t) (word << (64 - width - lsb)) >> (64 - width);
+}
+
+/* Bitpack_newu_fast
+ * Purpose: unchecked Bitpack_newu
+ * Parameters: word, width and lsb of the field, value that fits in width 
+ *              bits
+ * Returns: the updated word
+ */
+static inline uint64_t Bitpack_newu_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb, uint64_t value)
+{
+        uint64_t mask = Bitpack_mask_fast(width);
+        return (word & ~(mask << lsb)) | ((value & mask) << lsb);
+}
+
+/* Bitpack_news_fast
+ * Purpose: unchecked Bitpack_news
+ * Parameters: word, width and lsb of the field, value that fits in width 
+ *              bits (two's complement)
+ * Returns: the updated word
+ */
+static inline uint64_t Bitpack_news_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb, int64_t value)
+{
+        return Bitpack_newu_fast(word, width, lsb, (uint64_t) value);
+}
+
+#endif
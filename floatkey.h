@@ -0,0 +1,47 @@
+/*
+ *     floatkey.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains static inline functions that map floats to
+ *      unsigned keys in the same order, and back. The chroma and DCT
+ *      threshold builders (chroma.c, dct.c) bisect over the keys to find
+ *      the smallest float at which a quantizer steps up, visiting every
+ *      float between the ends of the search instead of a grid of them.
+ *
+ *     NaN has no place in the order and must not be given a key.
+ *
+ */
+
+#ifndef FLOATKEY_H
+#define FLOATKEY_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Floatkey_of
+ * Purpose: maps a (non NaN) float to an unsigned key with the same order
+ * Parameters: float
+ * Returns: its key; -0.0 comes just before 0.0
+ */
+static inline uint32_t Floatkey_of(float x)
+{
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+/* Floatkey_float
+ * Purpose: inverse of Floatkey_of
+ * Parameters: key
+ * Returns: the float with that key
+ */
+static inline float Floatkey_float(uint32_t key)
+{
+        uint32_t bits = (key & 0x80000000u) ? key & 0x7fffffffu : ~key;
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+}
+
+#endif
@@ -0,0 +1,439 @@
+/*
+ *     imagediff.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the image difference engine
+ *      whose declarations are included in imagediff.h.
+ *
+ *     Rows of 8 bit samples, the usual case, go through an SSE2 or AVX2
+ *      kernel picked at run time: absolute differences of 16 or 32 samples
+ *      at once, squared in 16 bit lanes and added up in 32 bit lanes, one
+ *      lane per position of a 48 or 96 byte chunk (16 or 32 pixels, so
+ *      every lane always holds the same channel). The lanes are moved into
+ *      the 64 bit per channel totals at the end of the row, or before they
+ *      could overflow. Rows with 16 bit samples, or two rasters of
+ *      different sample sizes, use the scalar kernel. Every kernel gives
+ *      exactly the same totals.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include "assert.h"
+#include "mem.h"
+#include "parallel.h"
+#include "imagediff.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* 32 bit lanes are flushed after at most this many chunks: each chunk adds
+ * at most 255 * 255 to a lane
+ */
+#define CHUNKS_PER_FLUSH 65536
+
+/* totals of one row */
+struct row_totals {
+        uint64_t sumSquares[3];
+        unsigned maxError[3];
+};
+
+/* the two rasters compared by Imagediff_add, and a row_totals per row */
+struct diff_cl {
+        Rawppm image1;
+        Rawppm image2;
+        int width;
+        struct row_totals *rows;
+};
+
+typedef void diff_row_fun(const unsigned char *a, const unsigned char *b,
+                          int width, struct row_totals *totals);
+
+static diff_row_fun diff_row_scalar;
+static diff_row_fun *diff_row = diff_row_scalar;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernel(void);
+static void diff_band(int firstRow, int lastRow, void *cl);
+static void diff_row_wide(const unsigned char *a, unsigned bytesA,
+                          const unsigned char *b, unsigned bytesB,
+                          int width, struct row_totals *totals);
+static inline unsigned get_sample(const unsigned char *row, unsigned bytes,
+                                  int i);
+
+/* Imagediff_clear
+ * Purpose: empties the totals
+ * Parameters: totals
+ * Returns: N/A
+ */
+void Imagediff_clear(Imagediff diff)
+{
+        assert(diff != NULL);
+
+        for (int c = 0; c < 3; c++) {
+                diff->sumSquares[c] = 0;
+                diff->maxError[c] = 0;
+        }
+        diff->pixels = 0;
+}
+
+/* Imagediff_add
+ * Purpose: compares the first width pixels of the first numRows rows of
+ *              two rasters and adds the differences to the totals. The
+ *              rows are spread over the Parallel_map_bands threads, then
+ *              added up in row order.
+ * Parameters: totals, the two images (with their raster attached, at least
+ *              width by numRows), width, number of rows
+ * Returns: N/A
+ */
+void Imagediff_add(Imagediff diff, Rawppm image1, Rawppm image2,
+                   unsigned width, unsigned numRows)
+{
+        assert(diff != NULL && image1 != NULL && image2 != NULL);
+        assert(image1->raster != NULL && image2->raster != NULL);
+        assert(width <= image1->width && width <= image2->width);
+        if (width == 0 || numRows == 0) {
+                return;
+        }
+        pthread_once(&kernel_once, choose_kernel);
+
+        struct diff_cl cl = { image1, image2, (int) width, NULL };
+        cl.rows = ALLOC((long) numRows * sizeof(struct row_totals));
+        Parallel_map_bands((int) numRows, diff_band, &cl);
+
+        for (unsigned row = 0; row < numRows; row++) {
+                for (int c = 0; c < 3; c++) {
+                        diff->sumSquares[c] += cl.rows[row].sumSquares[c];
+                        if (cl.rows[row].maxError[c] > diff->maxError[c]) {
+                                diff->maxError[c] = cl.rows[row].maxError[c];
+                        }
+                }
+        }
+        diff->pixels += (uint64_t) width * numRows;
+
+        FREE(cl.rows);
+}
+
+/* Imagediff_mse
+ * Purpose: mean squared difference of one channel, or of all three
+ * Parameters: totals, channel (IMAGEDIFF_RED ... IMAGEDIFF_ALL)
+ * Returns: mean squared difference, in samples squared (0 if no pixels)
+ */
+double Imagediff_mse(Imagediff diff, int channel)
+{
+        assert(diff != NULL && channel >= 0 && channel <= IMAGEDIFF_ALL);
+        if (diff->pixels == 0) {
+                return 0;
+        }
+
+        if (channel == IMAGEDIFF_ALL) {
+                uint64_t sum = diff->sumSquares[0] + diff->sumSquares[1] +
+                               diff->sumSquares[2];
+                return (double) sum / (3.0 * diff->pixels);
+        }
+        return (double) diff->sumSquares[channel] / diff->pixels;
+}
+
+/* Imagediff_rmse
+ * Purpose: root mean squared difference of one channel, or of all three
+ * Parameters: totals, channel
+ * Returns: RMSE, in samples
+ */
+double Imagediff_rmse(Imagediff diff, int channel)
+{
+        return sqrt(Imagediff_mse(diff, channel));
+}
+
+/* Imagediff_psnr
+ * Purpose: peak signal to noise ratio of one channel, or of all three
+ * Parameters: totals, channel, peak sample value (the denominator)
+ * Returns: PSNR in decibels, INFINITY for identical images
+ */
+double Imagediff_psnr(Imagediff diff, int channel, unsigned peak)
+{
+        double mse = Imagediff_mse(diff, channel);
+        if (mse == 0) {
+                return INFINITY;
+        }
+
+        return 10 * log10((double) peak * peak / mse);
+}
+
+/* Imagediff_max_error
+ * Purpose: largest difference of one channel, or of all three
+ * Parameters: totals, channel
+ * Returns: largest absolute difference, in samples
+ */
+unsigned Imagediff_max_error(Imagediff diff, int channel)
+{
+        assert(diff != NULL && channel >= 0 && channel <= IMAGEDIFF_ALL);
+        if (channel != IMAGEDIFF_ALL) {
+                return diff->maxError[channel];
+        }
+
+        unsigned max = diff->maxError[0];
+        for (int c = 1; c < 3; c++) {
+                if (diff->maxError[c] > max) {
+                        max = diff->maxError[c];
+                }
+        }
+        return max;
+}
+
+/* diff_band
+ * Purpose: band function: compares rows [firstRow, lastRow) into their
+ *              own row_totals
+ * Parameters: first row, one past the last row, diff_cl
+ * Returns: N/A
+ */
+static void diff_band(int firstRow, int lastRow, void *cl)
+{
+        struct diff_cl *diff = cl;
+        Rawppm image1 = diff->image1;
+        Rawppm image2 = diff->image2;
+        bool narrow = image1->bytesPerSample == 1 &&
+                      image2->bytesPerSample == 1;
+
+        for (int row = firstRow; row < lastRow; row++) {
+                const unsigned char *a = image1->raster +
+                                         (size_t) row * image1->rowBytes;
+                const unsigned char *b = image2->raster +
+                                         (size_t) row * image2->rowBytes;
+                struct row_totals *totals = &diff->rows[row];
+
+                for (int c = 0; c < 3; c++) {
+                        totals->sumSquares[c] = 0;
+                        totals->maxError[c] = 0;
+                }
+                if (narrow) {
+                        diff_row(a, b, diff->width, totals);
+                } else {
+                        diff_row_wide(a, image1->bytesPerSample, b,
+                                      image2->bytesPerSample, diff->width,
+                                      totals);
+                }
+        }
+}
+
+/* ======================================================================
+                        ROW KERNELS
+   ====================================================================== */
+
+/* diff_row_scalar
+ * Purpose: adds the differences of a row of 8 bit samples to its totals,
+ *              one sample at a time
+ */
+static void diff_row_scalar(const unsigned char *a, const unsigned char *b,
+                            int width, struct row_totals *totals)
+{
+        for (int i = 0; i < 3 * width; i++) {
+                int c = i % 3;
+                unsigned d = (a[i] > b[i]) ? a[i] - b[i] : b[i] - a[i];
+                totals->sumSquares[c] += d * d;
+                if (d > totals->maxError[c]) {
+                        totals->maxError[c] = d;
+                }
+        }
+}
+
+/* diff_row_wide
+ * Purpose: diff_row_scalar for rows with 16 bit (big endian) samples in
+ *              one or both rasters
+ */
+static void diff_row_wide(const unsigned char *a, unsigned bytesA,
+                          const unsigned char *b, unsigned bytesB,
+                          int width, struct row_totals *totals)
+{
+        for (int i = 0; i < 3 * width; i++) {
+                int c = i % 3;
+                unsigned x = get_sample(a, bytesA, i);
+                unsigned y = get_sample(b, bytesB, i);
+                uint64_t d = (x > y) ? x - y : y - x;
+                totals->sumSquares[c] += d * d;
+                if (d > totals->maxError[c]) {
+                        totals->maxError[c] = d;
+                }
+        }
+}
+
+/* get_sample
+ * Purpose: reads sample i of a row of 1 or 2 byte samples
+ */
+static inline unsigned get_sample(const unsigned char *row, unsigned bytes,
+                                  int i)
+{
+        if (bytes == 1) {
+                return row[i];
+        }
+        return (unsigned) row[2 * i] << 8 | row[2 * i + 1];
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* flush_lanes
+ * Purpose: moves the 32 bit lane sums and byte lane maxima of a chunk of
+ *              the given number of positions into the row totals
+ */
+static void flush_lanes(const uint32_t *sums, const unsigned char *maxes,
+                        int positions, struct row_totals *totals)
+{
+        for (int p = 0; p < positions; p++) {
+                totals->sumSquares[p % 3] += sums[p];
+                if (maxes[p] > totals->maxError[p % 3]) {
+                        totals->maxError[p % 3] = maxes[p];
+                }
+        }
+}
+
+/* diff_row_sse2
+ * Purpose: 48 samples (16 pixels) per iteration, in three 16 byte loads;
+ *              sums[4 * k + q] holds positions 16 * k + 4 * q to + 3
+ */
+__attribute__((target("sse2")))
+static void diff_row_sse2(const unsigned char *a, const unsigned char *b,
+                          int width, struct row_totals *totals)
+{
+        const __m128i zero = _mm_setzero_si128();
+        int bytes = 3 * width;
+        int i = 0;
+
+        while (i + 48 <= bytes) {
+                __m128i sums[12], maxes[3];
+                for (int k = 0; k < 12; k++) {
+                        sums[k] = zero;
+                }
+                for (int k = 0; k < 3; k++) {
+                        maxes[k] = zero;
+                }
+
+                for (int n = 0; n < CHUNKS_PER_FLUSH && i + 48 <= bytes;
+                     n++, i += 48) {
+                        for (int k = 0; k < 3; k++) {
+                                __m128i x = _mm_loadu_si128(
+                                        (const __m128i *) &a[i + 16 * k]);
+                                __m128i y = _mm_loadu_si128(
+                                        (const __m128i *) &b[i + 16 * k]);
+                                __m128i d = _mm_or_si128(_mm_subs_epu8(x, y),
+                                                         _mm_subs_epu8(y, x));
+                                maxes[k] = _mm_max_epu8(maxes[k], d);
+
+                                __m128i lo = _mm_unpacklo_epi8(d, zero);
+                                __m128i hi = _mm_unpackhi_epi8(d, zero);
+                                lo = _mm_mullo_epi16(lo, lo);
+                                hi = _mm_mullo_epi16(hi, hi);
+                                sums[4 * k] = _mm_add_epi32(sums[4 * k],
+                                        _mm_unpacklo_epi16(lo, zero));
+                                sums[4 * k + 1] = _mm_add_epi32(
+                                        sums[4 * k + 1],
+                                        _mm_unpackhi_epi16(lo, zero));
+                                sums[4 * k + 2] = _mm_add_epi32(
+                                        sums[4 * k + 2],
+                                        _mm_unpacklo_epi16(hi, zero));
+                                sums[4 * k + 3] = _mm_add_epi32(
+                                        sums[4 * k + 3],
+                                        _mm_unpackhi_epi16(hi, zero));
+                        }
+                }
+
+                uint32_t laneSums[48];
+                unsigned char laneMaxes[48];
+                for (int k = 0; k < 12; k++) {
+                        _mm_storeu_si128((__m128i *) &laneSums[4 * k],
+                                         sums[k]);
+                }
+                for (int k = 0; k < 3; k++) {
+                        _mm_storeu_si128((__m128i *) &laneMaxes[16 * k],
+                                         maxes[k]);
+                }
+                flush_lanes(laneSums, laneMaxes, 48, totals);
+        }
+        diff_row_scalar(a + i, b + i, (bytes - i) / 3, totals);
+}
+
+/* diff_row_avx2
+ * Purpose: 96 samples (32 pixels) per iteration, in three 32 byte loads;
+ *              widened with cvtepu so lanes stay in order: sums[4 * k + q]
+ *              holds positions 32 * k + 8 * q to + 7
+ */
+__attribute__((target("avx2")))
+static void diff_row_avx2(const unsigned char *a, const unsigned char *b,
+                          int width, struct row_totals *totals)
+{
+        int bytes = 3 * width;
+        int i = 0;
+
+        while (i + 96 <= bytes) {
+                __m256i sums[12], maxes[3];
+                for (int k = 0; k < 12; k++) {
+                        sums[k] = _mm256_setzero_si256();
+                }
+                for (int k = 0; k < 3; k++) {
+                        maxes[k] = _mm256_setzero_si256();
+                }
+
+                for (int n = 0; n < CHUNKS_PER_FLUSH && i + 96 <= bytes;
+                     n++, i += 96) {
+                        for (int k = 0; k < 3; k++) {
+                                __m256i x = _mm256_loadu_si256(
+                                        (const __m256i *) &a[i + 32 * k]);
+                                __m256i y = _mm256_loadu_si256(
+                                        (const __m256i *) &b[i + 32 * k]);
+                                __m256i d = _mm256_or_si256(
+                                        _mm256_subs_epu8(x, y),
+                                        _mm256_subs_epu8(y, x));
+                                maxes[k] = _mm256_max_epu8(maxes[k], d);
+
+                                for (int h = 0; h < 2; h++) {
+                                        __m128i half = (h == 0) ?
+                                            _mm256_castsi256_si128(d) :
+                                            _mm256_extracti128_si256(d, 1);
+                                        __m256i w = _mm256_cvtepu8_epi16(half);
+                                        w = _mm256_mullo_epi16(w, w);
+                                        __m256i *s = &sums[4 * k + 2 * h];
+                                        s[0] = _mm256_add_epi32(s[0],
+                                                _mm256_cvtepu16_epi32(
+                                                _mm256_castsi256_si128(w)));
+                                        s[1] = _mm256_add_epi32(s[1],
+                                                _mm256_cvtepu16_epi32(
+                                                _mm256_extracti128_si256(w,
+                                                                         1)));
+                                }
+                        }
+                }
+
+                uint32_t laneSums[96];
+                unsigned char laneMaxes[96];
+                for (int k = 0; k < 12; k++) {
+                        _mm256_storeu_si256((__m256i *) &laneSums[8 * k],
+                                            sums[k]);
+                }
+                for (int k = 0; k < 3; k++) {
+                        _mm256_storeu_si256((__m256i *) &laneMaxes[32 * k],
+                                            maxes[k]);
+                }
+                flush_lanes(laneSums, laneMaxes, 96, totals);
+        }
+        diff_row_sse2(a + i, b + i, (bytes - i) / 3, totals);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* choose_kernel
+ * Purpose: picks the fastest row kernel the CPU supports, run once
+ */
+static void choose_kernel(void)
+{
+#ifdef HAVE_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+                diff_row = diff_row_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+                diff_row = diff_row_sse2;
+        }
+#endif
+}
@@ -0,0 +1,42 @@
+/*
+ *     imagediff.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the image difference engine used
+ *      by ppmdiff. It compares the rows of two raw rasters (see rawppm.h)
+ *      band by band on the Parallel_map_bands threads and keeps, for each
+ *      channel, the exact sum of squared differences in 64 bits and the
+ *      largest difference, so that any number of row batches can be added
+ *      up before the RMSE and PSNR are computed.
+ *
+ */
+
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <stdint.h>
+#include "rawppm.h"
+
+/* channel numbers; IMAGEDIFF_ALL is the three channels together */
+#define IMAGEDIFF_RED 0
+#define IMAGEDIFF_GREEN 1
+#define IMAGEDIFF_BLUE 2
+#define IMAGEDIFF_ALL 3
+
+typedef struct Imagediff {
+        uint64_t sumSquares[3];
+        unsigned maxError[3];
+        uint64_t pixels;
+} *Imagediff;
+
+void Imagediff_clear(Imagediff diff);
+void Imagediff_add(Imagediff diff, Rawppm image1, Rawppm image2,
+                   unsigned width, unsigned numRows);
+
+double Imagediff_mse(Imagediff diff, int channel);
+double Imagediff_rmse(Imagediff diff, int channel);
+double Imagediff_psnr(Imagediff diff, int channel, unsigned peak);
+unsigned Imagediff_max_error(Imagediff diff, int channel);
+
+#endif
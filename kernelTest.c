@@ -0,0 +1,441 @@
+/*
+ *     kernelTest.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the unit test functions for the SIMD kernels of
+ *      colorspace.c and dct.c. Every kernel this CPU can run is compared
+ *      bit for bit with the scalar one on random rows and chunks of every
+ *      length (so the scalar tails are covered too). Each quantizeBCD
+ *      threshold the AVX2 quantizer searches is checked against quantizeBCD
+ *      on both of its sides; the quantizers are then checked against
+ *      quantizeBCD and round(a * 63.0) around every step and on random
+ *      floats, and the unquantizers on every code. Exits with 1 if any
+ *      answer differs.
+ *
+ */
+
+
+#include "colorspace.h"
+#include "dct.h"
+#include "compression.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NUM_KERNELS 3
+#define ROW_LENGTH 1000
+#define TRIALS 20
+/* floats checked on each side of every step of the quantizers */
+#define NEIGHBORS 16
+#define RANDOM_VALUES (1 << 23)
+
+static const char *kernels[NUM_KERNELS] = { "scalar", "sse2", "avx2" };
+
+uint64_t colorspace_tests();
+uint64_t forward_tests();
+uint64_t inverse_tests();
+uint64_t quantize_tests();
+uint64_t unquantize_tests();
+uint64_t threshold_tests();
+uint64_t quantize_values(const float *values, int count);
+uint64_t compare_floats(const char *what, const char *kernel,
+                       const float *expected, const float *actual, int n);
+float random_float(float low, float high);
+
+int main()
+{
+        uint64_t mismatches = 0;
+        srand(40);
+
+        printf("\n----COLORSPACE KERNEL TESTING----\n");
+        mismatches += colorspace_tests();
+
+        printf("\n----DCT KERNEL TESTING----\n");
+        mismatches += forward_tests();
+        mismatches += inverse_tests();
+
+        printf("\n----QUANTIZATION TESTING----\n");
+        mismatches += threshold_tests();
+        mismatches += quantize_tests();
+        mismatches += unquantize_tests();
+
+        printf("\n%lu mismatches in total\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+}
+
+/* colorspace_tests
+ * Purpose: converts random rows of every length up to 40 (and one long
+ *              row) both ways with every kernel and compares them with the
+ *              scalar kernel
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t colorspace_tests()
+{
+        static float in[3][ROW_LENGTH];
+        static float expected[3][ROW_LENGTH], actual[3][ROW_LENGTH];
+        uint64_t mismatches = 0;
+
+        for (int trial = 0; trial < TRIALS; trial++) {
+                for (int n = 0; n <= 41; n++) {
+                        int length = (n == 41) ? ROW_LENGTH : n;
+                        for (int c = 0; c < 3; c++) {
+                                for (int i = 0; i < length; i++) {
+                                        in[c][i] = random_float(-1.0, 1.0);
+                                }
+                        }
+
+                        Colorspace_use_kernel("scalar");
+                        Colorspace_rgb_to_ypbpr(in[0], in[1], in[2],
+                                                expected[0], expected[1],
+                                                expected[2], length);
+                        for (int k = 1; k < NUM_KERNELS; k++) {
+                                if (!Colorspace_use_kernel(kernels[k])) {
+                                        continue;
+                                }
+                                Colorspace_rgb_to_ypbpr(in[0], in[1], in[2],
+                                                        actual[0], actual[1],
+                                                        actual[2], length);
+                                for (int c = 0; c < 3; c++) {
+                                        mismatches += compare_floats(
+                                                "rgb_to_ypbpr", kernels[k],
+                                                expected[c], actual[c],
+                                                length);
+                                }
+                        }
+
+                        Colorspace_use_kernel("scalar");
+                        Colorspace_ypbpr_to_rgb(in[0], in[1], in[2],
+                                                expected[0], expected[1],
+                                                expected[2], length);
+                        for (int k = 1; k < NUM_KERNELS; k++) {
+                                if (!Colorspace_use_kernel(kernels[k])) {
+                                        continue;
+                                }
+                                Colorspace_ypbpr_to_rgb(in[0], in[1], in[2],
+                                                        actual[0], actual[1],
+                                                        actual[2], length);
+                                for (int c = 0; c < 3; c++) {
+                                        mismatches += compare_floats(
+                                                "ypbpr_to_rgb", kernels[k],
+                                                expected[c], actual[c],
+                                                length);
+                                }
+                        }
+                }
+        }
+
+        for (int k = 1; k < NUM_KERNELS; k++) {
+                printf("%s: %s\n", kernels[k],
+                       Colorspace_use_kernel(kernels[k]) ? "tested" :
+                                                "not supported, skipped");
+        }
+        printf("%lu mismatches over both conversions\n", mismatches);
+        return mismatches;
+}
+
+/* forward_tests
+ * Purpose: runs the forward DCT of random chunks of every size with every
+ *              kernel and compares them with the scalar kernel
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t forward_tests()
+{
+        static struct pixel_chunk chunk;
+        static struct DCT_batch expected, actual;
+        uint64_t mismatches = 0;
+
+        for (int trial = 0; trial < TRIALS; trial++) {
+                for (int n = 0; n <= ROW_CHUNK; n++) {
+                        for (int i = 0; i < 4 * n; i++) {
+                                chunk.y[i] = random_float(0.0, 1.0);
+                                chunk.pb[i] = random_float(-0.5, 0.5);
+                                chunk.pr[i] = random_float(-0.5, 0.5);
+                        }
+
+                        Dct_use_kernel("scalar");
+                        Dct_forward_batch(&chunk, n, &expected);
+                        for (int k = 1; k < NUM_KERNELS; k++) {
+                                if (!Dct_use_kernel(kernels[k])) {
+                                        continue;
+                                }
+                                Dct_forward_batch(&chunk, n, &actual);
+                                mismatches += compare_floats("forward a",
+                                        kernels[k], expected.a, actual.a, n);
+                                mismatches += compare_floats("forward b",
+                                        kernels[k], expected.b, actual.b, n);
+                                mismatches += compare_floats("forward c",
+                                        kernels[k], expected.c, actual.c, n);
+                                mismatches += compare_floats("forward d",
+                                        kernels[k], expected.d, actual.d, n);
+                                mismatches += compare_floats("forward pb",
+                                        kernels[k], expected.avgPb,
+                                        actual.avgPb, n);
+                                mismatches += compare_floats("forward pr",
+                                        kernels[k], expected.avgPr,
+                                        actual.avgPr, n);
+                        }
+                }
+        }
+
+        printf("%lu mismatches over the forward DCT\n", mismatches);
+        return mismatches;
+}
+
+/* inverse_tests
+ * Purpose: runs the inverse DCT of random chunks of every size with every
+ *              kernel and compares them with the scalar kernel
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t inverse_tests()
+{
+        static struct DCT_batch dct;
+        static struct pixel_chunk expected, actual;
+        uint64_t mismatches = 0;
+
+        for (int trial = 0; trial < TRIALS; trial++) {
+                for (int n = 0; n <= ROW_CHUNK; n++) {
+                        for (int i = 0; i < n; i++) {
+                                dct.a[i] = random_float(0.0, 1.0);
+                                dct.b[i] = random_float(-0.3, 0.3);
+                                dct.c[i] = random_float(-0.3, 0.3);
+                                dct.d[i] = random_float(-0.3, 0.3);
+                                dct.avgPb[i] = random_float(-0.5, 0.5);
+                                dct.avgPr[i] = random_float(-0.5, 0.5);
+                        }
+
+                        Dct_use_kernel("scalar");
+                        Dct_inverse_batch(&dct, n, &expected);
+                        for (int k = 1; k < NUM_KERNELS; k++) {
+                                if (!Dct_use_kernel(kernels[k])) {
+                                        continue;
+                                }
+                                Dct_inverse_batch(&dct, n, &actual);
+                                mismatches += compare_floats("inverse y",
+                                        kernels[k], expected.y, actual.y,
+                                        4 * n);
+                                mismatches += compare_floats("inverse pb",
+                                        kernels[k], expected.pb, actual.pb,
+                                        4 * n);
+                                mismatches += compare_floats("inverse pr",
+                                        kernels[k], expected.pr, actual.pr,
+                                        4 * n);
+                        }
+                }
+        }
+
+        printf("%lu mismatches over the inverse DCT\n", mismatches);
+        return mismatches;
+}
+
+/* threshold_tests
+ * Purpose: checks every threshold of the AVX2 quantizer against
+ *              quantizeBCD: the threshold itself must reach its level and
+ *              the float just below it must not
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t threshold_tests()
+{
+        float thresholds[DCT_BCD_LEVELS];
+        int lowest;
+        int count = Dct_bcd_thresholds(thresholds, &lowest);
+        uint64_t mismatches = 0;
+
+        for (int j = 0; j < count; j++) {
+                int level = lowest + j + 1;
+                float below = nextafterf(thresholds[j], -INFINITY);
+                if (quantizeBCD(thresholds[j]) < level ||
+                    quantizeBCD(below) >= level) {
+                        printf("threshold %d (%a): quantizeBCD gives %d, "
+                               "and %d just below, for level %d\n", j,
+                               thresholds[j], quantizeBCD(thresholds[j]),
+                               quantizeBCD(below), level);
+                        mismatches++;
+                }
+        }
+
+        printf("%lu mismatches over %d thresholds\n", mismatches, count);
+        return mismatches;
+}
+
+/* quantize_tests
+ * Purpose: quantizes, with every kernel, the floats within NEIGHBORS ulps
+ *              of every quantizeBCD threshold and of every point where
+ *              round(a * 63.0) steps, then RANDOM_VALUES random floats in
+ *              [-1, 1]
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t quantize_tests()
+{
+        static float values[RANDOM_VALUES];
+        float thresholds[DCT_BCD_LEVELS];
+        int lowest, count = 0;
+        int numThresholds = Dct_bcd_thresholds(thresholds, &lowest);
+        uint64_t mismatches = 0, tested = 0;
+
+        for (int j = 0; j < numThresholds + 63; j++) {
+                float edge = (j < numThresholds) ? thresholds[j] :
+                                (float) ((j - numThresholds + 0.5) / 63.0);
+                float x = edge;
+                for (int i = 0; i < NEIGHBORS; i++) {
+                        x = nextafterf(x, -INFINITY);
+                }
+                for (int i = 0; i <= 2 * NEIGHBORS; i++) {
+                        values[count++] = x;
+                        x = nextafterf(x, INFINITY);
+                }
+        }
+        mismatches += quantize_values(values, count);
+        tested += count;
+
+        for (int i = 0; i < RANDOM_VALUES; i++) {
+                values[i] = random_float(-1.0, 1.0);
+        }
+        mismatches += quantize_values(values, RANDOM_VALUES);
+        tested += RANDOM_VALUES;
+
+        printf("%lu mismatches over %lu values\n", mismatches, tested);
+        return mismatches;
+}
+
+/* quantize_values
+ * Purpose: quantizes values, ROW_CHUNK at a time, as a, b, c and d with
+ *              every kernel and compares the codes with round(a * 63.0)
+ *              and quantizeBCD. Negative values are only checked as b, c
+ *              and d (a is never negative).
+ * Parameters: values, number of values
+ * Returns: number of mismatches
+ */
+uint64_t quantize_values(const float *values, int count)
+{
+        static struct DCT_batch dct;
+        static struct DCT_quant_batch quant;
+        static uint64_t printed = 0;
+        uint64_t mismatches = 0;
+
+        for (int first = 0; first < count; first += ROW_CHUNK) {
+                int n = (count - first < ROW_CHUNK) ? count - first : 
+                                                        ROW_CHUNK;
+                for (int i = 0; i < n; i++) {
+                        float x = values[first + i];
+                        dct.a[i] = (x < 0) ? 0.0 : x;
+                        dct.b[i] = x;
+                        dct.c[i] = x;
+                        dct.d[i] = x;
+                        dct.avgPb[i] = 0.0;
+                        dct.avgPr[i] = 0.0;
+                }
+
+                for (int k = 0; k < NUM_KERNELS; k++) {
+                        if (!Dct_use_kernel(kernels[k])) {
+                                continue;
+                        }
+                        Dct_quantize_batch(&dct, n, &quant);
+                        for (int i = 0; i < n; i++) {
+                                unsigned a = (unsigned) round(dct.a[i] * 63.0);
+                                int bcd = quantizeBCD(dct.b[i]);
+                                if (quant.a[i] == a && quant.b[i] == bcd &&
+                                    quant.c[i] == bcd && quant.d[i] == bcd) {
+                                        continue;
+                                }
+                                if (printed++ < 10) {
+                                        printf("%s %a: expected %u and %d, "
+                                               "got %u, %d, %d, %d\n",
+                                               kernels[k], dct.b[i], a, bcd,
+                                               quant.a[i], quant.b[i],
+                                               quant.c[i], quant.d[i]);
+                                }
+                                mismatches++;
+                        }
+                }
+        }
+
+        return mismatches;
+}
+
+/* unquantize_tests
+ * Purpose: unquantizes every 6 bit code of a, b, c and d with every kernel
+ *              and compares the values with the scalar helpers
+ * Parameters: n/a
+ * Returns: number of mismatches
+ */
+uint64_t unquantize_tests()
+{
+        static struct DCT_quant_batch quant;
+        static struct DCT_batch dct;
+        float a[DCT_BCD_LEVELS], bcd[DCT_BCD_LEVELS];
+        uint64_t mismatches = 0;
+
+        for (int code = 0; code < DCT_BCD_LEVELS; code++) {
+                quant.a[code] = code;
+                quant.b[code] = code - 32;
+                quant.c[code] = code - 32;
+                quant.d[code] = code - 32;
+                quant.pb[code] = code % 16;
+                quant.pr[code] = code % 16;
+                a[code] = ((float) code) / 63.0;
+                bcd[code] = unquantizeBCD(code - 32);
+        }
+
+        for (int k = 0; k < NUM_KERNELS; k++) {
+                if (!Dct_use_kernel(kernels[k])) {
+                        continue;
+                }
+                Dct_unquantize_batch(&quant, DCT_BCD_LEVELS, &dct);
+                mismatches += compare_floats("unquantize a", kernels[k], a,
+                                             dct.a, DCT_BCD_LEVELS);
+                mismatches += compare_floats("unquantize b", kernels[k], bcd,
+                                             dct.b, DCT_BCD_LEVELS);
+                mismatches += compare_floats("unquantize c", kernels[k], bcd,
+                                             dct.c, DCT_BCD_LEVELS);
+                mismatches += compare_floats("unquantize d", kernels[k], bcd,
+                                             dct.d, DCT_BCD_LEVELS);
+        }
+
+        printf("%lu mismatches over every code\n", mismatches);
+        return mismatches;
+}
+
+/* compare_floats
+ * Purpose: compares two arrays bit for bit, prints the first few
+ *              mismatches
+ * Parameters: what was computed, kernel that computed it, expected and
+ *              actual values, number of values
+ * Returns: number of mismatches
+ */
+uint64_t compare_floats(const char *what, const char *kernel,
+                       const float *expected, const float *actual, int n)
+{
+        static uint64_t printed = 0;
+        uint64_t mismatches = 0;
+
+        for (int i = 0; i < n; i++) {
+                if (memcmp(&expected[i], &actual[i], sizeof(float)) == 0) {
+                        continue;
+                }
+                if (printed++ < 10) {
+                        printf("%s (%s) [%d]: expected %a, got %a\n", what,
+                               kernel, i, expected[i], actual[i]);
+                }
+                mismatches++;
+        }
+
+        return mismatches;
+}
+
+/* random_float
+ * Purpose: returns a random float in [low, high]
+ * Parameters: bounds of the range
+ * Returns: the float
+ */
+float random_float(float low, float high)
+{
+        return low + (high - low) * ((float) rand() / (float) RAND_MAX);
+}
@@ -0,0 +1,235 @@
+/*
+ *     memtrack.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains an implementation of Hanson's mem.h that accounts
+ *      for the memory it hands out, and the memtrack.h functions to read
+ *      the accounts. Allocation and freeing behave as in the CII mem.c
+ *      (a failed allocation raises Mem_Failed). Every block is counted at
+ *      the size the allocator really holds for it (malloc_usable_size), so
+ *      the same size is taken off when it is freed, without any header in
+ *      front of the block. The band-parallel stages may allocate from
+ *      several threads, so the counters are updated atomically. Without
+ *      glibc the block sizes are not known and every byte count stays 0;
+ *      the number of allocations and the bytes asked for are always kept.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "assert.h"
+#include "except.h"
+#include "mem.h"
+#include "memtrack.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define held_bytes(ptr) ((int64_t) malloc_usable_size(ptr))
+#else
+#define held_bytes(ptr) ((int64_t) 0)
+#endif
+
+const Except_T Mem_Failed = { "Allocation Failed" };
+
+static int64_t live = 0;
+static int64_t peak = 0;
+static int64_t stage_peak = 0;
+static uint64_t allocations = 0;
+static uint64_t allocated = 0;
+
+static void *check_allocation(void *ptr, const char *file, int line);
+static void account(int64_t bytes);
+static void count_allocation(long nbytes);
+static void raise_to(int64_t *max, int64_t value);
+
+/* Mem_alloc
+ * Purpose: allocates nbytes bytes, as ALLOC and NEW
+ * Parameters: number of bytes (more than 0), where it was called from
+ * Returns: the new block
+ * Raises: Mem_Failed if malloc fails
+ */
+void *Mem_alloc(long nbytes, const char *file, int line)
+{
+        assert(nbytes > 0);
+        void *ptr = check_allocation(malloc(nbytes), file, line);
+        account(held_bytes(ptr));
+        count_allocation(nbytes);
+
+        return ptr;
+}
+
+/* Mem_calloc
+ * Purpose: allocates count zeroed elements of nbytes bytes, as CALLOC
+ * Parameters: number of elements and size of one (more than 0), where it
+ *              was called from
+ * Returns: the new block
+ * Raises: Mem_Failed if calloc fails
+ */
+void *Mem_calloc(long count, long nbytes, const char *file, int line)
+{
+        assert(count > 0 && nbytes > 0);
+        void *ptr = check_allocation(calloc(count, nbytes), file, line);
+        account(held_bytes(ptr));
+        count_allocation(count * nbytes);
+
+        return ptr;
+}
+
+/* Mem_free
+ * Purpose: frees a block, as FREE; NULL is allowed
+ * Parameters: block, where it was called from
+ * Returns: N/A
+ */
+void Mem_free(void *ptr, const char *file, int line)
+{
+        (void) file;
+        (void) line;
+
+        if (ptr != NULL) {
+                account(-held_bytes(ptr));
+                free(ptr);
+        }
+}
+
+/* Mem_resize
+ * Purpose: changes the size of a block, as RESIZE
+ * Parameters: block (not NULL), new size (more than 0), where it was
+ *              called from
+ * Returns: the moved or resized block
+ * Raises: Mem_Failed if realloc fails
+ */
+void *Mem_resize(void *ptr, long nbytes, const char *file, int line)
+{
+        assert(ptr != NULL && nbytes > 0);
+        int64_t before = held_bytes(ptr);
+
+        void *resized = check_allocation(realloc(ptr, nbytes), file, line);
+        account(held_bytes(resized) - before);
+        count_allocation(nbytes);
+
+        return resized;
+}
+
+/* Memtrack_live
+ * Purpose: returns the bytes allocated and not freed yet
+ * Parameters: N/A
+ * Returns: live bytes
+ */
+uint64_t Memtrack_live(void)
+{
+        return __atomic_load_n(&live, __ATOMIC_RELAXED);
+}
+
+/* Memtrack_peak
+ * Purpose: returns the most bytes that were ever live at once
+ * Parameters: N/A
+ * Returns: peak bytes
+ */
+uint64_t Memtrack_peak(void)
+{
+        return __atomic_load_n(&peak, __ATOMIC_RELAXED);
+}
+
+/* Memtrack_stage_peak
+ * Purpose: returns the most bytes live at once since the current stage
+ *              started
+ * Parameters: N/A
+ * Returns: peak bytes of the stage
+ */
+uint64_t Memtrack_stage_peak(void)
+{
+        return __atomic_load_n(&stage_peak, __ATOMIC_RELAXED);
+}
+
+/* Memtrack_start_stage
+ * Purpose: starts a new stage, whose peak starts at what is live now
+ * Parameters: N/A
+ * Returns: N/A
+ */
+void Memtrack_start_stage(void)
+{
+        __atomic_store_n(&stage_peak, __atomic_load_n(&live,
+                         __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+/* Memtrack_allocations
+ * Purpose: returns the number of allocations and resizes made so far
+ * Parameters: N/A
+ * Returns: number of allocations
+ */
+uint64_t Memtrack_allocations(void)
+{
+        return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+/* Memtrack_allocated
+ * Purpose: returns the bytes every allocation and resize so far asked for
+ * Parameters: N/A
+ * Returns: bytes asked for
+ */
+uint64_t Memtrack_allocated(void)
+{
+        return __atomic_load_n(&allocated, __ATOMIC_RELAXED);
+}
+
+/* check_allocation
+ * Purpose: raises Mem_Failed for a failed allocation, the way mem.c does
+ * Parameters: what the allocator returned, where it was called from
+ * Returns: the block, if there is one
+ */
+static void *check_allocation(void *ptr, const char *file, int line)
+{
+        if (ptr == NULL) {
+                if (file == NULL) {
+                        RAISE(Mem_Failed);
+                } else {
+                        Except_raise(&Mem_Failed, file, line);
+                }
+        }
+
+        return ptr;
+}
+
+/* account
+ * Purpose: adds to the live bytes and raises the peaks to match
+ * Parameters: bytes allocated (or, negative, freed)
+ * Returns: N/A
+ */
+static void account(int64_t bytes)
+{
+        int64_t now = __atomic_add_fetch(&live, bytes, __ATOMIC_RELAXED);
+
+        if (bytes > 0) {
+                raise_to(&peak, now);
+                raise_to(&stage_peak, now);
+        }
+}
+
+/* count_allocation
+ * Purpose: counts one allocation or resize and the bytes it asked for
+ * Parameters: bytes asked for
+ * Returns: N/A
+ */
+static void count_allocation(long nbytes)
+{
+        __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&allocated, (uint64_t) nbytes, __ATOMIC_RELAXED);
+}
+
+/* raise_to
+ * Purpose: atomically raises a maximum to value if it is lower
+ * Parameters: maximum, new value
+ * Returns: N/A
+ */
+static void raise_to(int64_t *max, int64_t value)
+{
+        int64_t current = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+        while (current < value &&
+               !__atomic_compare_exchange_n(max, &current, value, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+        }
+}
@@ -0,0 +1,38 @@
+/*
+ *     memtrack.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the memory accounting. memtrack.c
+ *      is another implementation of Hanson's mem.h (like mem.c and
+ *      memchk.c): linked in ahead of the CII library, every NEW, ALLOC,
+ *      CALLOC, RESIZE and FREE in the program goes through it, including
+ *      the ones inside UArray2_new and UArray2b_new behind the A2Methods
+ *      new and free. It keeps the number of bytes held from the allocator,
+ *      the peak of the whole run and the peak of the current stage, and
+ *      how many allocations were made and how many bytes they asked for.
+ *
+ */
+
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stdint.h>
+
+/* bytes allocated and not freed yet */
+uint64_t Memtrack_live(void);
+
+/* most bytes ever live at once */
+uint64_t Memtrack_peak(void);
+
+/* most bytes live at once since the last Memtrack_start_stage */
+uint64_t Memtrack_stage_peak(void);
+void Memtrack_start_stage(void);
+
+/* allocations made so far (ALLOC, NEW, CALLOC and RESIZE) and the bytes
+ * they asked for, never taken off when blocks are freed
+ */
+uint64_t Memtrack_allocations(void);
+uint64_t Memtrack_allocated(void);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ *     outputBench.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains a throughput benchmark for the output stage of the
+ *      compressor. It fills a codeword array of the given size with random
+ *      codewords, then writes it to standard output with the per byte 
+ *      putchar writer (map_row_major and output_codeword) and with the bulk
+ *      writer (write_compressed), and reports the speed of each in GB/s on
+ *      standard error. Redirect standard output to /dev/null to time the 
+ *      writers alone, or to a file to include the file system.
+ *
+ *     Usage: output_bench [width height [repetitions]] > destination
+ *            (width and height in codewords, default 2048 by 2048)
+ *     
+ */ 
+
+#include "compression.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+void write_putchar(A2Methods_UArray2 codewords, A2Methods_T methods, 
+                   FILE *output);
+void write_bulk(A2Methods_UArray2 codewords, A2Methods_T methods, 
+                FILE *output);
+double time_writer(void (*writer)(A2Methods_UArray2, A2Methods_T, FILE *),
+                   A2Methods_UArray2 codewords, int reps);
+
+int main(int argc, char *argv[])
+{
+        if (argc != 1 && argc != 3 && argc != 4) {
+                fprintf(stderr, "Usage: %s [width height [repetitions]]\n", 
+                                                                argv[0]);
+                exit(EXIT_FAILURE);
+        }
+        int width = (argc >= 3) ? atoi(argv[1]) : 2048;
+        int height = (argc >= 3) ? atoi(argv[2]) : 2048;
+        int reps = (argc == 4) ? atoi(argv[3]) : 3;
+        assert(width > 0 && height > 0 && reps >= 1);
+
+        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_UArray2 codewords = methods->new(width, height, 
+                                                   sizeof(uint32_t));
+        srand(40);
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        uint32_t *codeword = methods->at(codewords, col, row);
+                        *codeword = ((uint32_t) rand() << 16) ^ 
+                                    (uint32_t) rand();
+                }
+        }
+
+        double gigabytes = 4.0 * width * height / 1e9;
+        double perByte = time_writer(write_putchar, codewords, reps);
+        double bulk = time_writer(write_bulk, codewords, reps);
+
+        fprintf(stderr, "writer,seconds,gigabytes_per_second\n");
+        fprintf(stderr, "putchar,%.6f,%.3f\n", perByte, gigabytes / perByte);
+        fprintf(stderr, "bulk,%.6f,%.3f\n", bulk, gigabytes / bulk);
+        fprintf(stderr, "speedup,%.2f\n", perByte / bulk);
+
+        methods->free(&codewords);
+        return 0;
+}
+
+/* write_putchar
+ * Purpose: the original output stage: header, then four putchar calls per
+ *              codeword through map_row_major
+ * Parameters: codewords, methods to use on them, file (must be stdout)
+ * Returns: N/A
+ */
+void write_putchar(A2Methods_UArray2 codewords, A2Methods_T methods, 
+                   FILE *output)
+{
+        (void) output;
+        printf("COMP40 Compressed image format 2\n%u %u\n", 
+               methods->width(codewords), methods->height(codewords));
+        methods->map_row_major(codewords, output_codeword, NULL);
+}
+
+/* write_bulk
+ * Purpose: the buffered output stage, see write_compressed
+ * Parameters: codewords, methods to use on them, file to write to
+ * Returns: N/A
+ */
+void write_bulk(A2Methods_UArray2 codewords, A2Methods_T methods, 
+                FILE *output)
+{
+        write_compressed(codewords, methods, output);
+}
+
+/* time_writer
+ * Purpose: times a writer, including flushing standard output
+ * Parameters: writer, codewords, number of repetitions
+ * Returns: best time in seconds
+ */
+double time_writer(void (*writer)(A2Methods_UArray2, A2Methods_T, FILE *),
+                   A2Methods_UArray2 codewords, int reps)
+{
+        double best = -1.0;
+
+        for (int i = 0; i < reps; i++) {
+                double start = Timing_seconds(CLOCK_MONOTONIC);
+                writer(codewords, uarray2_methods_plain, stdout);
+                fflush(stdout);
+
+                double seconds = Timing_seconds(CLOCK_MONOTONIC) - start;
+                if (best < 0 || seconds < best) {
+                        best = seconds;
+                }
+        }
+
+        return best;
+}
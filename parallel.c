@@ -0,0 +1,306 @@
+/*
+ *     parallel.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the band-parallel helpers
+ *      whose declarations are included in parallel.h. The work runs on a
+ *      pool of pthreads that is started the first time it is needed and
+ *      then reused by every later call. Each call splits its rows into one
+ *      contiguous share per thread; a thread takes small bands off the
+ *      front of its own share, and when that runs out it steals the back
+ *      half of another thread's share. Bands never overlap, so as long as
+ *      the apply function only writes to its own rows the result does not
+ *      depend on the number of threads or on scheduling.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "assert.h"
+#include "mem.h"
+#include "parallel.h"
+
+/* number of bands handed out per thread, more bands balance the load better
+ * when some rows are slower than others
+ */
+#define BANDS_PER_THREAD 4
+
+static int num_threads = 1;
+
+/* rows [next, end) of a job that one thread still owns */
+struct share {
+        pthread_mutex_t lock;
+        int next;
+        int end;
+};
+
+/* a new helper's number and the last generation it must not run */
+struct helper_start {
+        int id;
+        unsigned long seen;
+};
+
+/* one call to Parallel_map_bands; thread 0 is the caller */
+struct job {
+        int workers;
+        int bandHeight;
+        struct share *shares;
+        Parallel_bandfun *apply;
+        void *cl;
+};
+
+/* the pool: helper threads 1..numHelpers wait for a new generation */
+static struct {
+        pthread_mutex_t callLock;       /* one job at a time */
+        pthread_mutex_t lock;
+        pthread_cond_t start;
+        pthread_cond_t done;
+        int numHelpers;
+        unsigned long generation;
+        int busy;                       /* helpers still on the job */
+        struct job *job;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0,
+           NULL };
+
+/* set on pool threads, and on the caller while it runs a job, so a nested
+ * call runs serially instead of waiting on the pool it is part of
+ */
+static __thread bool in_pool = false;
+
+static void start_helpers(int helpers);
+static void *helper_main(void *vstart);
+static void run_job(struct job *job, int id);
+static bool next_band(struct job *job, int id, int *firstRow, int *lastRow);
+static bool steal(struct job *job, int id);
+
+/* Parallel_set_threads
+ * Purpose: sets the number of threads used by Parallel_map_bands
+ * Parameters: number of threads, at least 1 (1 means run serially)
+ * Returns: N/A
+ */
+void Parallel_set_threads(int threads)
+{
+        assert(threads >= 1);
+        num_threads = threads;
+}
+
+/* Parallel_threads
+ * Purpose: returns the number of threads used by Parallel_map_bands
+ * Parameters: N/A
+ * Returns: number of threads
+ */
+int Parallel_threads(void)
+{
+        return num_threads;
+}
+
+/* Parallel_map_bands
+ * Purpose: calls apply on every band of rows in [0, numRows), spreading the
+ *              bands over the configured number of threads. The calling
+ *              thread works on bands too, and all bands are done when this
+ *              returns. Called from inside an apply function, it runs the
+ *              rows serially.
+ * Parameters: number of rows, band apply function, closure
+ * Returns: N/A
+ */
+void Parallel_map_bands(int numRows, Parallel_bandfun *apply, void *cl)
+{
+        assert(numRows >= 0 && apply != NULL);
+
+        int threads = num_threads;
+        if (threads > numRows) {
+                threads = numRows;
+        }
+        if (threads <= 1 || in_pool) {
+                apply(0, numRows, cl);
+                return;
+        }
+
+        struct job job;
+        job.workers = threads;
+        job.bandHeight = numRows / (threads * BANDS_PER_THREAD);
+        if (job.bandHeight < 1) {
+                job.bandHeight = 1;
+        }
+        job.apply = apply;
+        job.cl = cl;
+
+        /* every thread starts with an even, contiguous share of the rows */
+        job.shares = ALLOC(threads * sizeof(struct share));
+        for (int i = 0; i < threads; i++) {
+                pthread_mutex_init(&job.shares[i].lock, NULL);
+                job.shares[i].next = (int) ((long) numRows * i / threads);
+                job.shares[i].end = (int) ((long) numRows * (i + 1) /
+                                                                threads);
+        }
+
+        pthread_mutex_lock(&pool.callLock);
+        start_helpers(threads - 1);
+
+        pthread_mutex_lock(&pool.lock);
+        pool.job = &job;
+        pool.busy = pool.numHelpers;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.start);
+        pthread_mutex_unlock(&pool.lock);
+
+        in_pool = true;
+        run_job(&job, 0);
+        in_pool = false;
+
+        pthread_mutex_lock(&pool.lock);
+        while (pool.busy > 0) {
+                pthread_cond_wait(&pool.done, &pool.lock);
+        }
+        pool.job = NULL;
+        pthread_mutex_unlock(&pool.lock);
+        pthread_mutex_unlock(&pool.callLock);
+
+        for (int i = 0; i < threads; i++) {
+                pthread_mutex_destroy(&job.shares[i].lock);
+        }
+        FREE(job.shares);
+}
+
+/* start_helpers
+ * Purpose: grows the pool to at least the given number of helper threads;
+ *              helpers are never stopped, later calls reuse them
+ * Parameters: number of helper threads needed (callLock held)
+ * Returns: N/A
+ */
+static void start_helpers(int helpers)
+{
+        while (pool.numHelpers < helpers) {
+                pthread_t thread;
+                struct helper_start *start;
+                NEW(start);
+
+                pthread_mutex_lock(&pool.lock);
+                start->id = pool.numHelpers + 1;
+                start->seen = pool.generation;
+                int created = pthread_create(&thread, NULL, helper_main,
+                                             start);
+                assert(created == 0);
+                pthread_detach(thread);
+                pool.numHelpers++;
+                pthread_mutex_unlock(&pool.lock);
+        }
+}
+
+/* helper_main
+ * Purpose: helper thread body: waits for each new job, works on it if the
+ *              job needs this many threads, then reports that it is done
+ * Parameters: helper_start holding its thread number (1 or more) and the
+ *              generation before its first job, freed here
+ * Returns: never returns
+ */
+static void *helper_main(void *vstart)
+{
+        struct helper_start *start = vstart;
+        int id = start->id;
+        unsigned long seen = start->seen;
+        FREE(start);
+        in_pool = true;
+
+        pthread_mutex_lock(&pool.lock);
+        while (true) {
+                while (pool.generation == seen) {
+                        pthread_cond_wait(&pool.start, &pool.lock);
+                }
+                seen = pool.generation;
+                struct job *job = pool.job;
+                pthread_mutex_unlock(&pool.lock);
+
+                if (id < job->workers) {
+                        run_job(job, id);
+                }
+
+                pthread_mutex_lock(&pool.lock);
+                if (--pool.busy == 0) {
+                        pthread_cond_signal(&pool.done);
+                }
+        }
+
+        return NULL;
+}
+
+/* run_job
+ * Purpose: applies the band function to bands from this thread's share,
+ *              stealing from other shares when it runs dry, until no rows
+ *              are left anywhere
+ * Parameters: job, thread number
+ * Returns: N/A
+ */
+static void run_job(struct job *job, int id)
+{
+        int firstRow, lastRow;
+
+        while (true) {
+                if (next_band(job, id, &firstRow, &lastRow)) {
+                        job->apply(firstRow, lastRow, job->cl);
+                } else if (!steal(job, id)) {
+                        break;
+                }
+        }
+}
+
+/* next_band
+ * Purpose: takes the next band off the front of this thread's share
+ * Parameters: job, thread number, destination for the band's rows
+ * Returns: true if a band was taken, false if the share is empty
+ */
+static bool next_band(struct job *job, int id, int *firstRow, int *lastRow)
+{
+        struct share *share = &job->shares[id];
+        bool found = false;
+
+        pthread_mutex_lock(&share->lock);
+        if (share->next < share->end) {
+                *firstRow = share->next;
+                share->next += job->bandHeight;
+                if (share->next > share->end) {
+                        share->next = share->end;
+                }
+                *lastRow = share->next;
+                found = true;
+        }
+        pthread_mutex_unlock(&share->lock);
+
+        return found;
+}
+
+/* steal
+ * Purpose: moves the back half of the first other share that still has
+ *              rows into this thread's (empty) share
+ * Parameters: job, thread number
+ * Returns: true if rows were stolen, false if every share is empty
+ */
+static bool steal(struct job *job, int id)
+{
+        for (int i = 1; i < job->workers; i++) {
+                struct share *victim = &job->shares[(id + i) % job->workers];
+
+                pthread_mutex_lock(&victim->lock);
+                int left = victim->end - victim->next;
+                if (left <= 0) {
+                        pthread_mutex_unlock(&victim->lock);
+                        continue;
+                }
+                int taken = (left + 1) / 2;
+                int end = victim->end;
+                victim->end -= taken;
+                pthread_mutex_unlock(&victim->lock);
+
+                struct share *share = &job->shares[id];
+                pthread_mutex_lock(&share->lock);
+                share->next = end - taken;
+                share->end = end;
+                pthread_mutex_unlock(&share->lock);
+                return true;
+        }
+
+        return false;
+}
@@ -0,0 +1,23 @@
+/*
+ *     parallel.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the band-parallel helpers used
+ *      to spread independent rows of work (e.g. rows of 2x2 blocks, or the
+ *      tiles of an A2Methods map_parallel) over a work stealing pool of 
+ *      pthreads.
+ *     
+ */ 
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* apply function for one band: rows [firstRow, lastRow) */
+typedef void Parallel_bandfun(int firstRow, int lastRow, void *cl);
+
+void Parallel_set_threads(int threads);
+int Parallel_threads(void);
+void Parallel_map_bands(int numRows, Parallel_bandfun *apply, void *cl);
+
+#endif
@@ -6,81 +6,154 @@
  *     This file contains the implementation of ppmdiff, which calculates
  *      the difference between two ppm files used for testing the
  *      accuracy of compression and decompression.
- *     
- */ 
+ *
+ *     Raw (P6) files are streamed: a batch of rows of each file is read
+ *      with one fread, compared on all threads by the difference engine
+ *      (see imagediff.h), and the buffer is reused for the next batch, so
+ *      memory does not grow with the height of the image. Other formats
+ *      are read whole through netpbm first. After the original DIFF VAL
+ *      line it prints the RMSE, PSNR and largest error of every channel.
+ *
+ *     Usage: ppmdiff [-j N] image1.ppm image2.ppm
+ *            (-j: number of threads, by default one per online CPU)
+ *
+ */
 
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "pnm.h"
 #include "a2methods.h"
 #include "assert.h"
 #include "a2plain.h"
-#include "a2blocked.h"
-#include "uarray2b.h"
+#include "mem.h"
+#include "rawppm.h"
+#include "imagediff.h"
+#include "parallel.h"
 #include "stdbool.h"
 #include "math.h"
 
-Pnm_ppm read_image(char *file_name, A2Methods_T methods); 
-bool valid_dimensions(Pnm_ppm image1, Pnm_ppm image2);
-float image_difference (Pnm_ppm image1, Pnm_ppm image2);
-int min(int a, int b);
-int square(int x);
+/* bytes of each file read per batch of rows */
+#define BATCH_BYTES (8 << 20)
+
+/* one of the images being compared */
+struct source {
+        FILE *fp;
+        struct Rawppm image;
+        bool streamed;                  /* rows are read batch by batch */
+        unsigned char *batch;
+};
+
+void open_image(char *file_name, struct source *source);
+void close_image(struct source *source);
+bool valid_dimensions(Rawppm image1, Rawppm image2);
+void image_difference(struct source *source1, struct source *source2,
+                      Imagediff diff);
+void batch_rows(struct source *source, unsigned firstRow, unsigned numRows,
+                struct Rawppm *rows);
+void print_difference(Imagediff diff, unsigned peak);
+unsigned min(unsigned a, unsigned b);
 
 int main(int argc, char* argv[]) {
-        if (argc != 3) {
-                fprintf(stderr, "Incorrect number of command line arguments\n");
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int threads = (cpus > 0) ? (int) cpus : 1;
+        int i = 1;
+
+        if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+                threads = atoi(argv[2]);
+                i = 3;
+        }
+        if (argc - i != 2 || threads < 1) {
+                fprintf(stderr, "Usage: %s [-j N] image1.ppm image2.ppm\n",
+                        argv[0]);
                 exit(EXIT_FAILURE);
         }
-        
-        /* default to UArray2 methods */
-        A2Methods_T methods = uarray2_methods_plain; 
-        assert(methods);
-
-        Pnm_ppm image1 = read_image(argv[1], methods);
-        Pnm_ppm image2 = read_image(argv[2], methods);
-        if (!valid_dimensions(image1, image2)) {
+        Parallel_set_threads(threads);
+
+        struct source source1, source2;
+        open_image(argv[i], &source1);
+        open_image(argv[i + 1], &source2);
+        if (!valid_dimensions(&source1.image, &source2.image)) {
                 exit(EXIT_FAILURE);
         }
-        float diff_val = image_difference(image1, image2);
 
-        printf("DIFF VAL: %f\n", diff_val);
+        struct Imagediff diff;
+        image_difference(&source1, &source2, &diff);
+
+        unsigned peak = source1.image.denominator;
+        if (source2.image.denominator > peak) {
+                peak = source2.image.denominator;
+        }
+        print_difference(&diff, peak);
 
-        Pnm_ppmfree(&image1);
-        Pnm_ppmfree(&image2);
+        close_image(&source1);
+        close_image(&source2);
 
         return(0);
 }
 
-/* 
-* Description: read a ppm image frm a file and return it as a pnmppm
-* Input: file name and methods 
-* Returns: Pnm_ppm
+/*
+* Description: open a ppm image and read its header. A raw ppm is left to
+*               be streamed; any other format is read whole by netpbm.
+* Input: file name and the source to fill in
+* Returns: N/A
 */
-Pnm_ppm read_image(char *file_name, A2Methods_T methods) 
+void open_image(char *file_name, struct source *source)
 {
-        FILE *filep = fopen(file_name,"r");
-        assert(filep != NULL);
+        FILE *fp = fopen(file_name, "r");
+        assert(fp != NULL);
+        source->fp = fp;
+        source->batch = NULL;
+        source->streamed = Rawppm_read_header(&source->fp, &source->image);
+
+        if (!source->streamed) {
+                /* netpbm reads source->fp from its start; a named pipe
+                 * leaves a copy of its input in its place (see rawppm.c)
+                 */
+                if (source->fp != fp) {
+                        fclose(fp);
+                }
+                Pnm_ppm pnm = Pnm_ppmread(source->fp, uarray2_methods_plain);
+                Rawppm_from_pnm(pnm, &source->image);
+                Pnm_ppmfree(&pnm);
+        }
+}
 
-        return Pnm_ppmread(filep, methods);
-} 
+/*
+* Description: free what open_image allocated and close the file
+* Input: the source
+* Returns: N/A
+*/
+void close_image(struct source *source)
+{
+        if (source->streamed) {
+                FREE(source->batch);
+        } else {
+                Rawppm_free_raster(&source->image);
+        }
+        fclose(source->fp);
+}
 
-/* 
-* Description: Check that there is a maximum difference of 1 between the 
-*               dimensions of the two pnm_ppms
-* Input: The two Pnm_ppms being compared 
+/*
+* Description: Check that there is a maximum difference of 1 between the
+*               dimensions of the two images, whichever one is larger: a
+*               second image 2 or more pixels wider or taller than the first
+*               is rejected, the same as a first image that is
+* Input: The two images being compared
 * Returns: boolean representing success of dimension read
 */
-bool valid_dimensions(Pnm_ppm image1, Pnm_ppm image2)
+bool valid_dimensions(Rawppm image1, Rawppm image2)
 {
         bool valid = true;
-        if (image1->width - image2->width > 1) {
+        if (abs((int) image1->width - (int) image2->width) > 1) {
                 fprintf(stderr, "Width difference greater than 1\n");
                 printf( "1.0\n");
                 valid = false;
         }
 
-        if (image1->height - image2->height > 1) {
+        if (abs((int) image1->height - (int) image2->height) > 1) {
                 fprintf(stderr, "Height difference greater than 1\n");
                 printf("1.0\n");
                 valid = false;
@@ -88,53 +161,93 @@ bool valid_dimensions(Pnm_ppm image1, Pnm_ppm image2)
         return valid;
 }
 
-/* 
-* Description: calculate the difference between the two images
-* Input: The two Pnm_ppms being compared 
-* Returns: Value representing image difference
+/*
+* Description: compare the pixels the two images share, a batch of rows at
+*               a time
+* Input: the two images, the totals to fill in
+* Returns: N/A
+*/
+void image_difference(struct source *source1, struct source *source2,
+                      Imagediff diff)
+{
+        unsigned width = min(source1->image.width, source2->image.width);
+        unsigned height = min(source1->image.height, source2->image.height);
+        size_t rowBytes = source1->image.rowBytes;
+        if (source2->image.rowBytes > rowBytes) {
+                rowBytes = source2->image.rowBytes;
+        }
+        unsigned batchRows = min(BATCH_BYTES / rowBytes, height);
+        if (batchRows < 1) {
+                batchRows = 1;
+        }
+
+        Imagediff_clear(diff);
+        for (unsigned row = 0; row < height; row += batchRows) {
+                unsigned numRows = min(batchRows, height - row);
+                struct Rawppm rows1, rows2;
+
+                batch_rows(source1, row, numRows, &rows1);
+                batch_rows(source2, row, numRows, &rows2);
+                Imagediff_add(diff, &rows1, &rows2, width, numRows);
+        }
+}
+
+/*
+* Description: get the next batch of rows of an image: read into the
+*               source's buffer when streamed, else point into its raster
+* Input: the source, first row and number of rows of the batch (rows are
+*               asked for in order), image to describe the batch with
+* Returns: N/A
 */
-float image_difference (Pnm_ppm image1, Pnm_ppm image2) 
+void batch_rows(struct source *source, unsigned firstRow, unsigned numRows,
+                struct Rawppm *rows)
 {
-        int width = min(image1->width, image2->width);
-        int height = min(image1->height, image2->height);
-        float redDiff, blueDiff, greenDiff, sum = 0;
-        
-        for (int j = 0; j < height; j++) {
-                for (int i = 0; i < width; i++) {
-                        Pnm_rgb image1pixel = image1->methods->at(image1->pixels, i, j);
-                        Pnm_rgb image2pixel = image2->methods->at(image2->pixels, i, j);
-                        redDiff = square(image1pixel->red - image2pixel->red);
-                        greenDiff = square(image1pixel->green - image2pixel->green);
-                        blueDiff = square(image1pixel->blue - image2pixel->blue);
-                        sum += (redDiff + greenDiff + blueDiff);
+        *rows = source->image;
+        rows->height = numRows;
 
-                }
+        if (!source->streamed) {
+                rows->raster = source->image.raster +
+                               (size_t) firstRow * source->image.rowBytes;
+                return;
         }
 
-        float diff_val = sqrt(sum / (3 * width * height));
+        size_t size = (size_t) numRows * source->image.rowBytes;
+        if (source->batch == NULL) {
+                source->batch = ALLOC(size + 1);
+        }
+        size_t read = fread(source->batch, 1, size, source->fp);
+        assert(read == size);
+        rows->raster = source->batch;
+}
 
-        return diff_val;
+/*
+* Description: print the overall difference (in samples, as ppmdiff always
+*               has), then RMSE, PSNR and largest error of each channel
+* Input: the totals, the peak sample value for the PSNR
+* Returns: N/A
+*/
+void print_difference(Imagediff diff, unsigned peak)
+{
+        static const char *names[4] = { "red", "green", "blue", "all" };
+
+        printf("DIFF VAL: %f\n", Imagediff_rmse(diff, IMAGEDIFF_ALL));
+        printf("channel,rmse,psnr_db,max_error\n");
+        for (int c = IMAGEDIFF_RED; c <= IMAGEDIFF_ALL; c++) {
+                printf("%s,%.6f,%.4f,%u\n", names[c], Imagediff_rmse(diff, c),
+                       Imagediff_psnr(diff, c, peak),
+                       Imagediff_max_error(diff, c));
+        }
 }
 
-/* 
+/*
 * Description: find the minimum of two numbers
 * Input: two integers to compare
 * Returns: the minimum of the two numbers
 */
-int min(int a, int b) 
+unsigned min(unsigned a, unsigned b)
 {
         if (a > b) {
                 return b;
         }
         return a;
 }
-
-/* 
-* Description: find the square of a number x
-* Input: number to square
-* Returns: squared number
-*/
-int square(int x)
-{
-        return x * x;
-}
\ No newline at end of file
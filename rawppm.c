@@ -0,0 +1,393 @@
+/*
+ *     rawppm.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the native raw (P6) PPM
+ *      reader and writer whose declarations are included in rawppm.h. The
+ *      header is parsed by hand; the raster is mapped from the file when
+ *      the file is a regular file, and read with a single fread otherwise.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "mem.h"
+#include "rawppm.h"
+#include "stats.h"
+
+static unsigned read_header_number(FILE *fp, uint64_t *count);
+static void push_back(int c, FILE *fp);
+static FILE *buffered_input(FILE *fp, int magic1, int magic2);
+
+/* Rawppm_read_header
+ * Purpose: parses a raw (P6) PPM header, leaving *fpp at the first byte of
+ *              the raster. Comments are allowed anywhere a number may go.
+ *              No raster is attached to the image yet.
+ * Parameters: pointer to the file to read from, image to fill in
+ * Returns: true for a raw PPM. False if the file does not start with the
+ *              P6 magic number; *fpp then reads the file from its start,
+ *              for netpbm. A single byte read is pushed back and a
+ *              seekable file is sought back. A pipe that began with 'P'
+ *              can not be given two bytes back (ISO C promises one byte of
+ *              pushback), so its whole input is read into a memory stream
+ *              and *fpp is set to that. The caller closes it with fclose;
+ *              the original stream is left at its end, still the caller's.
+ */
+bool Rawppm_read_header(FILE **fpp, Rawppm image)
+{
+        assert(fpp != NULL && *fpp != NULL && image != NULL);
+        FILE *fp = *fpp;
+        long start = ftell(fp);
+
+        int magic1 = getc(fp);
+        if (magic1 != 'P') {
+                push_back(magic1, fp);
+                return false;
+        }
+        int magic2 = getc(fp);
+        if (magic2 != '6') {
+                if (start < 0 || fseek(fp, start, SEEK_SET) != 0) {
+                        *fpp = buffered_input(fp, magic1, magic2);
+                }
+                return false;
+        }
+
+        uint64_t count = 2;
+        image->width = read_header_number(fp, &count);
+        image->height = read_header_number(fp, &count);
+        image->denominator = read_header_number(fp, &count);
+        Stats_count_read(count);
+
+        assert(image->width > 0 && image->height > 0);
+        assert(image->denominator > 0 && image->denominator < 65536);
+
+        image->bytesPerSample = (image->denominator < 256) ? 1 : 2;
+        image->rowBytes = (size_t) image->width * 3 * image->bytesPerSample;
+        image->raster = NULL;
+        image->buffer = NULL;
+        image->map = NULL;
+        image->mapLength = 0;
+
+        return true;
+}
+
+/* Rawppm_read_raster
+ * Purpose: attaches the whole raster to an image whose header was just
+ *              read. A regular file is mapped (read only, private) and the
+ *              raster points into the mapping; anything else, or a file
+ *              that can not be mapped, is read into one buffer.
+ * Parameters: file positioned at the raster, image from Rawppm_read_header
+ * Returns: N/A
+ */
+void Rawppm_read_raster(FILE *fp, Rawppm image)
+{
+        assert(fp != NULL && image != NULL);
+        size_t size = image->rowBytes * image->height;
+
+        struct stat info;
+        long offset = ftell(fp);
+        if (offset >= 0 && fstat(fileno(fp), &info) == 0 &&
+            S_ISREG(info.st_mode) && info.st_size > 0) {
+                /* a short file would fault on the mapping, not fail fread */
+                assert((uint64_t) info.st_size >= (uint64_t) offset + size);
+
+                void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+                                 fileno(fp), 0);
+                if (map != MAP_FAILED) {
+                        madvise(map, info.st_size, MADV_SEQUENTIAL);
+                        image->map = map;
+                        image->mapLength = info.st_size;
+                        image->raster = (unsigned char *) map + offset;
+                        Stats_count_read(size);
+                        return;
+                }
+        }
+
+        image->buffer = ALLOC(size + 1);
+        size_t read = fread(image->buffer, 1, size, fp);
+        assert(read == size);
+        image->raster = image->buffer;
+        Stats_count_read(size);
+}
+
+/* Rawppm_read_row
+ * Purpose: reads the next row of the raster with a single fread, for
+ *              callers that stream the image instead of attaching a raster
+ * Parameters: file to read from, image from Rawppm_read_header,
+ *              destination of rowBytes bytes
+ * Returns: N/A
+ */
+void Rawppm_read_row(FILE *fp, Rawppm image, unsigned char *row)
+{
+        size_t read = fread(row, 1, image->rowBytes, fp);
+        assert(read == image->rowBytes);
+        Stats_count_read(read);
+}
+
+/* Rawppm_free_raster
+ * Purpose: unmaps or frees the raster attached by Rawppm_read_raster
+ * Parameters: image
+ * Returns: N/A
+ */
+void Rawppm_free_raster(Rawppm image)
+{
+        assert(image != NULL);
+
+        if (image->map != NULL) {
+                munmap(image->map, image->mapLength);
+        }
+        if (image->buffer != NULL) {
+                FREE(image->buffer);
+        }
+        image->map = NULL;
+        image->mapLength = 0;
+        image->raster = NULL;
+}
+
+/* Rawppm_from_pnm
+ * Purpose: copies an image read by netpbm (any PPM format) into a raster
+ *              of its own, laid out as if it had been read from a raw PPM
+ *              with the same denominator
+ * Parameters: source image, image to fill in (free with Rawppm_free_raster)
+ * Returns: N/A
+ */
+void Rawppm_from_pnm(Pnm_ppm source, Rawppm image)
+{
+        assert(source != NULL && image != NULL);
+        assert(source->denominator > 0 && source->denominator < 65536);
+
+        image->width = source->width;
+        image->height = source->height;
+        image->denominator = source->denominator;
+        image->bytesPerSample = (image->denominator < 256) ? 1 : 2;
+        image->rowBytes = (size_t) image->width * 3 * image->bytesPerSample;
+        image->map = NULL;
+        image->mapLength = 0;
+        image->buffer = ALLOC(image->rowBytes * image->height + 1);
+        image->raster = image->buffer;
+
+        unsigned char *sample = image->buffer;
+        for (unsigned row = 0; row < image->height; row++) {
+                for (unsigned col = 0; col < image->width; col++) {
+                        Pnm_rgb pixel = source->methods->at(source->pixels,
+                                                            col, row);
+                        unsigned rgb[3] = { pixel->red, pixel->green,
+                                            pixel->blue };
+                        for (int c = 0; c < 3; c++) {
+                                if (image->bytesPerSample == 2) {
+                                        *sample++ = rgb[c] >> 8;
+                                }
+                                *sample++ = rgb[c] & 0xff;
+                        }
+                }
+        }
+}
+
+/* Rawppm_rescale
+ * Purpose: copies a raster into one of its own with another denominator,
+ *              scaling each sample the way the codec does: divided by the
+ *              old denominator as a float, multiplied by the new one and
+ *              truncated (so a raster scaled to 255 is on the scale of what
+ *              the decompressor writes)
+ * Parameters: image with its raster attached, new denominator, image to
+ *              fill in (free with Rawppm_free_raster)
+ * Returns: N/A
+ */
+void Rawppm_rescale(Rawppm source, unsigned denominator, Rawppm image)
+{
+        assert(source != NULL && source->raster != NULL && image != NULL);
+        assert(denominator > 0 && denominator < 65536);
+
+        image->width = source->width;
+        image->height = source->height;
+        image->denominator = denominator;
+        image->bytesPerSample = (denominator < 256) ? 1 : 2;
+        image->rowBytes = (size_t) image->width * 3 * image->bytesPerSample;
+        image->map = NULL;
+        image->mapLength = 0;
+        image->buffer = ALLOC(image->rowBytes * image->height + 1);
+        image->raster = image->buffer;
+
+        const unsigned char *in = source->raster;
+        unsigned char *out = image->buffer;
+        size_t samples = (size_t) image->width * image->height * 3;
+        for (size_t i = 0; i < samples; i++) {
+                unsigned value = *in++;
+                if (source->bytesPerSample == 2) {
+                        value = value << 8 | *in++;
+                }
+                float x = (float) value / source->denominator;
+                unsigned scaled = (unsigned) (x * denominator);
+                if (scaled > denominator) {
+                        scaled = denominator;
+                }
+                if (image->bytesPerSample == 2) {
+                        *out++ = scaled >> 8;
+                }
+                *out++ = scaled & 0xff;
+        }
+}
+
+/* Rawppm_to_pnm
+ * Purpose: copies a raster into a new Pnm_ppm, the image Pnm_ppmread would
+ *              have returned for the same file
+ * Parameters: image with its raster attached, methods for the pixel array
+ * Returns: the image, freed with Pnm_ppmfree
+ */
+Pnm_ppm Rawppm_to_pnm(Rawppm image, A2Methods_T methods)
+{
+        assert(image != NULL && image->raster != NULL && methods != NULL);
+
+        Pnm_ppm pnm;
+        NEW(pnm);
+        pnm->width = image->width;
+        pnm->height = image->height;
+        pnm->denominator = image->denominator;
+        pnm->methods = methods;
+        pnm->pixels = methods->new(image->width, image->height,
+                                   sizeof(struct Pnm_rgb));
+
+        const unsigned char *sample = image->raster;
+        for (unsigned row = 0; row < image->height; row++) {
+                for (unsigned col = 0; col < image->width; col++) {
+                        unsigned rgb[3];
+                        for (int c = 0; c < 3; c++) {
+                                rgb[c] = *sample++;
+                                if (image->bytesPerSample == 2) {
+                                        rgb[c] = rgb[c] << 8 | *sample++;
+                                }
+                        }
+                        Pnm_rgb pixel = methods->at(pnm->pixels, col, row);
+                        pixel->red = rgb[0];
+                        pixel->green = rgb[1];
+                        pixel->blue = rgb[2];
+                }
+        }
+
+        return pnm;
+}
+
+/* Rawppm_write_header
+ * Purpose: writes the header of a raw PPM with denominator 255, the same
+ *              header Pnm_ppmwrite writes
+ * Parameters: file to write to, width and height in pixels
+ * Returns: N/A
+ */
+void Rawppm_write_header(FILE *fp, unsigned width, unsigned height)
+{
+        int written = fprintf(fp, "P6\n%u %u\n%u\n", width, height, 255);
+        assert(written > 0);
+        Stats_count_written(written);
+}
+
+/* Rawppm_write_rows
+ * Purpose: writes contiguous rows of 8 bit pixels with a single fwrite
+ * Parameters: file to write to, rows (3 * width bytes each), width in
+ *              pixels, number of rows
+ * Returns: N/A
+ */
+void Rawppm_write_rows(FILE *fp, const unsigned char *rows, unsigned width,
+                       unsigned numRows)
+{
+        size_t size = (size_t) width * 3 * numRows;
+        size_t written = fwrite(rows, 1, size, fp);
+        assert(written == size);
+        Stats_count_written(written);
+}
+
+/* read_header_number
+ * Purpose: reads one decimal number of a PPM header, skipping whitespace
+ *              and comments before it and the single whitespace after it
+ * Parameters: file to read from, count of header bytes read, updated
+ * Returns: the number read, which must fit in an int (the image goes on
+ *              to int indexed arrays)
+ */
+static unsigned read_header_number(FILE *fp, uint64_t *count)
+{
+        int c = getc(fp);
+        (*count)++;
+        while (isspace(c) || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(fp);
+                                (*count)++;
+                        }
+                }
+                c = getc(fp);
+                (*count)++;
+        }
+        assert(isdigit(c));
+
+        unsigned number = 0;
+        while (isdigit(c)) {
+                /* stop before the next digit could overflow */
+                assert(number <= (INT_MAX - (unsigned) (c - '0')) / 10);
+                number = number * 10 + (c - '0');
+                c = getc(fp);
+                (*count)++;
+        }
+        assert(isspace(c));
+
+        return number;
+}
+
+/* push_back
+ * Purpose: pushes a byte read with getc back onto a stream; EOF is not
+ *              pushed back (the stream stays at its end)
+ * Parameters: byte (or EOF), stream it was read from
+ * Returns: N/A
+ */
+static void push_back(int c, FILE *fp)
+{
+        if (c == EOF) {
+                return;
+        }
+        int pushed = ungetc(c, fp);
+        assert(pushed == c);
+}
+
+/* buffered_input
+ * Purpose: copies the magic bytes already read from a stream that can not
+ *              be sought back and everything left in it into a memory
+ *              stream, so the input can be read again from its start
+ * Parameters: stream, first and second byte read from it (the second may
+ *              be EOF)
+ * Returns: memory stream positioned at its start, closed with fclose
+ *              (which also frees its buffer)
+ */
+static FILE *buffered_input(FILE *fp, int magic1, int magic2)
+{
+        size_t capacity = 1 << 16;
+        size_t length = 0;
+        unsigned char *data = ALLOC(capacity);
+
+        data[length++] = magic1;
+        if (magic2 != EOF) {
+                data[length++] = magic2;
+        }
+        size_t got;
+        while ((got = fread(data + length, 1, capacity - length, fp)) > 0) {
+                length += got;
+                if (length == capacity) {
+                        capacity *= 2;
+                        RESIZE(data, capacity);
+                }
+        }
+        assert(!ferror(fp));
+
+        FILE *copy = fmemopen(NULL, length, "w+");
+        assert(copy != NULL);
+        size_t written = fwrite(data, 1, length, copy);
+        assert(written == length);
+        rewind(copy);
+        FREE(data);
+
+        return copy;
+}
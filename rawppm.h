@@ -0,0 +1,48 @@
+/*
+ *     rawppm.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the native raw (P6) PPM reader
+ *      and writer. Pixels stay in one contiguous raster of 3 samples per
+ *      pixel (1 byte per sample if the denominator is below 256, otherwise
+ *      2 big endian bytes), read with one fread or mapped straight from the
+ *      file, instead of being converted into a UArray2 of Pnm_rgb structs.
+ *
+ */
+
+#ifndef RAWPPM_H
+#define RAWPPM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pnm.h"
+
+typedef struct Rawppm {
+        unsigned width, height, denominator;
+        unsigned bytesPerSample;        /* 1 or 2 */
+        size_t rowBytes;                /* 3 * width * bytesPerSample */
+
+        /* height rows of rowBytes, set by Rawppm_read_raster */
+        const unsigned char *raster;
+
+        /* where the raster lives: a read buffer or a mapping of the file */
+        unsigned char *buffer;
+        void *map;
+        size_t mapLength;
+} *Rawppm;
+
+bool Rawppm_read_header(FILE **fpp, Rawppm image);
+void Rawppm_read_raster(FILE *fp, Rawppm image);
+void Rawppm_read_row(FILE *fp, Rawppm image, unsigned char *row);
+void Rawppm_free_raster(Rawppm image);
+void Rawppm_from_pnm(Pnm_ppm source, Rawppm image);
+void Rawppm_rescale(Rawppm source, unsigned denominator, Rawppm image);
+Pnm_ppm Rawppm_to_pnm(Rawppm image, A2Methods_T methods);
+
+void Rawppm_write_header(FILE *fp, unsigned width, unsigned height);
+void Rawppm_write_rows(FILE *fp, const unsigned char *rows, unsigned width,
+                       unsigned numRows);
+
+#endif
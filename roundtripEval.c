@@ -0,0 +1,319 @@
+/*
+ *     roundtripEval.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the round trip evaluator. For every image it loads
+ *      the file once, compresses it with compressedImage and decompresses
+ *      the codewords with decompressedImage, all in memory, then compares
+ *      the result with the original (see imagediff.h). It replaces
+ *      40image -c, 40image -d and ppmdiff, with their two temporary files,
+ *      for quality and speed sweeps. The decompressor always writes
+ *      denominator 255, so an original with any other denominator is first
+ *      scaled to 255 the way the codec scales samples, and the PSNR peak is
+ *      255.
+ *
+ *     Images are spread over the Parallel_map_bands threads, one image per
+ *      thread at a time (each image's own stages then run serially on its
+ *      thread). Encode and decode times are wall times on that thread; use
+ *      -j 1 when the times matter more than the throughput. Results are
+ *      printed as CSV in the order the images were given, a directory
+ *      standing for its .ppm and .pnm files in name order.
+ *
+ *     Usage: roundtrip_eval [-j N] directory|image.ppm ...
+ *            (-j: number of threads, by default one per online CPU)
+ *
+ */
+
+#include "compression.h"
+#include "imagediff.h"
+#include "parallel.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <mem.h>
+
+/* the measurements of one image */
+struct result {
+        char *path;
+        unsigned width, height;
+        double encodeSeconds;
+        double decodeSeconds;
+        uint64_t compressedBytes;
+        struct Imagediff diff;
+};
+
+/* the images of one run */
+struct batch {
+        struct result *results;
+        int count;
+        int capacity;
+};
+
+/* netpbm is not known to be thread safe: other formats load one at a time */
+static pthread_mutex_t pnm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void add_path(struct batch *batch, const char *path);
+void add_directory(struct batch *batch, const char *path);
+int compare_names(const void *a, const void *b);
+bool is_image_name(const char *name);
+void evaluate_band(int first, int last, void *cl);
+void evaluate(struct result *result);
+Pnm_ppm load_image(const char *path, struct Rawppm *raw);
+void print_result(struct result *result);
+
+int main(int argc, char *argv[])
+{
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int threads = (cpus > 0) ? (int) cpus : 1;
+        int i = 1;
+
+        if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+                threads = atoi(argv[2]);
+                i = 3;
+        }
+        if (i >= argc || threads < 1) {
+                fprintf(stderr, "Usage: %s [-j N] directory|image.ppm ...\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+        Parallel_set_threads(threads);
+
+        struct batch batch = { NULL, 0, 0 };
+        for (; i < argc; i++) {
+                add_path(&batch, argv[i]);
+        }
+
+        double start = Timing_seconds(CLOCK_MONOTONIC);
+        Parallel_map_bands(batch.count, evaluate_band, &batch);
+        double seconds = Timing_seconds(CLOCK_MONOTONIC) - start;
+
+        printf("file,width,height,encode_seconds,decode_seconds,"
+               "compressed_bytes,bits_per_pixel,rmse,psnr_db,max_error\n");
+        for (int r = 0; r < batch.count; r++) {
+                print_result(&batch.results[r]);
+                FREE(batch.results[r].path);
+        }
+        fprintf(stderr, "%d images in %.3f seconds on %d threads\n",
+                batch.count, seconds, threads);
+
+        FREE(batch.results);
+        return EXIT_SUCCESS;
+}
+
+/* add_path
+ * Purpose: adds an image, or every image of a directory, to the batch
+ * Parameters: batch, path of an image or a directory
+ * Returns: N/A
+ */
+void add_path(struct batch *batch, const char *path)
+{
+        struct stat info;
+        if (stat(path, &info) != 0) {
+                fprintf(stderr, "roundtrip_eval: can not open '%s'\n", path);
+                exit(EXIT_FAILURE);
+        }
+        if (S_ISDIR(info.st_mode)) {
+                add_directory(batch, path);
+                return;
+        }
+
+        if (batch->count == batch->capacity) {
+                batch->capacity = 2 * batch->capacity + 16;
+                long size = batch->capacity * sizeof(struct result);
+                if (batch->results == NULL) {
+                        batch->results = ALLOC(size);
+                } else {
+                        RESIZE(batch->results, size);
+                }
+        }
+        struct result *result = &batch->results[batch->count++];
+        result->path = ALLOC(strlen(path) + 1);
+        strcpy(result->path, path);
+}
+
+/* add_directory
+ * Purpose: adds the .ppm and .pnm files of a directory, in name order
+ * Parameters: batch, path of the directory
+ * Returns: N/A
+ */
+void add_directory(struct batch *batch, const char *path)
+{
+        DIR *dir = opendir(path);
+        assert(dir != NULL);
+
+        int count = 0, capacity = 16;
+        char **names = ALLOC(capacity * sizeof(char *));
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+                if (!is_image_name(entry->d_name)) {
+                        continue;
+                }
+                if (count == capacity) {
+                        capacity *= 2;
+                        RESIZE(names, capacity * sizeof(char *));
+                }
+                names[count] = ALLOC(strlen(path) + strlen(entry->d_name) + 2);
+                sprintf(names[count], "%s/%s", path, entry->d_name);
+                count++;
+        }
+        closedir(dir);
+
+        qsort(names, count, sizeof(char *), compare_names);
+        for (int i = 0; i < count; i++) {
+                add_path(batch, names[i]);
+                FREE(names[i]);
+        }
+        FREE(names);
+}
+
+/* compare_names
+ * Purpose: qsort comparison of two path strings
+ * Parameters: pointers to the two char * paths
+ * Returns: strcmp of the paths
+ */
+int compare_names(const void *a, const void *b)
+{
+        return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* is_image_name
+ * Purpose: tells whether a directory entry looks like an image
+ * Parameters: file name
+ * Returns: true for names ending in .ppm or .pnm
+ */
+bool is_image_name(const char *name)
+{
+        size_t length = strlen(name);
+
+        return length > 4 && (strcmp(name + length - 4, ".ppm") == 0 ||
+                              strcmp(name + length - 4, ".pnm") == 0);
+}
+
+/* evaluate_band
+ * Purpose: band function: evaluates images [first, last) of the batch
+ * Parameters: first image, one past the last image, batch
+ * Returns: N/A
+ */
+void evaluate_band(int first, int last, void *cl)
+{
+        struct batch *batch = cl;
+
+        for (int i = first; i < last; i++) {
+                evaluate(&batch->results[i]);
+        }
+}
+
+/* evaluate
+ * Purpose: loads one image, round trips it through the staged compressor
+ *              and decompressor and measures the result
+ * Parameters: result, with the path filled in
+ * Returns: N/A
+ */
+void evaluate(struct result *result)
+{
+        struct Rawppm original;
+        Pnm_ppm image = load_image(result->path, &original);
+        result->width = image->width;
+        result->height = image->height;
+
+        double start = Timing_seconds(CLOCK_MONOTONIC);
+        A2Methods_UArray2 codewords = compressedImage(image);
+        double encoded = Timing_seconds(CLOCK_MONOTONIC);
+        A2Methods_UArray2 pixels = decompressedImage(codewords);
+        double decoded = Timing_seconds(CLOCK_MONOTONIC);
+        result->encodeSeconds = encoded - start;
+        result->decodeSeconds = decoded - encoded;
+
+        /* the size of the file 40image -c would write */
+        unsigned width = uarray2_methods_plain->width(codewords);
+        unsigned height = uarray2_methods_plain->height(codewords);
+        int header = snprintf(NULL, 0, "COMP40 Compressed image format 2\n"
+                              "%u %u\n", width, height);
+        result->compressedBytes = header + 4 * (uint64_t) width * height;
+
+        /* compare with the file 40image -d would write, on its scale */
+        if (original.denominator != 255) {
+                struct Rawppm scaled;
+                Rawppm_rescale(&original, 255, &scaled);
+                Rawppm_free_raster(&original);
+                original = scaled;
+        }
+        struct Pnm_ppm output = {
+                .width = uarray2_methods_plain->width(pixels),
+                .height = uarray2_methods_plain->height(pixels),
+                .denominator = 255, .pixels = pixels,
+                .methods = uarray2_methods_plain };
+        struct Rawppm decompressed;
+        Rawppm_from_pnm(&output, &decompressed);
+        Imagediff_clear(&result->diff);
+        Imagediff_add(&result->diff, &original, &decompressed,
+                      (original.width < decompressed.width) ?
+                                original.width : decompressed.width,
+                      (original.height < decompressed.height) ?
+                                original.height : decompressed.height);
+
+        Rawppm_free_raster(&decompressed);
+        Rawppm_free_raster(&original);
+        uarray2_methods_plain->free(&pixels);
+        uarray2_methods_plain->free(&codewords);
+        Pnm_ppmfree(&image);
+}
+
+/* load_image
+ * Purpose: reads an image once, keeping both the raster (for the
+ *              comparison) and a Pnm_ppm (for the compressor)
+ * Parameters: path, Rawppm to attach the raster to
+ * Returns: the image, freed with Pnm_ppmfree (the raster is freed with
+ *              Rawppm_free_raster)
+ */
+Pnm_ppm load_image(const char *path, struct Rawppm *raw)
+{
+        FILE *file = fopen(path, "r");
+        assert(file != NULL);
+        FILE *fp = file;
+        Pnm_ppm image;
+
+        if (Rawppm_read_header(&fp, raw)) {
+                Rawppm_read_raster(fp, raw);
+                image = Rawppm_to_pnm(raw, uarray2_methods_plain);
+        } else {
+                /* netpbm reads fp from its start; a named pipe leaves a
+                 * copy of its input in its place (see rawppm.c)
+                 */
+                if (fp != file) {
+                        fclose(file);
+                }
+                pthread_mutex_lock(&pnm_lock);
+                image = Pnm_ppmread(fp, uarray2_methods_plain);
+                pthread_mutex_unlock(&pnm_lock);
+                Rawppm_from_pnm(image, raw);
+        }
+
+        fclose(fp);
+        return image;
+}
+
+/* print_result
+ * Purpose: prints one CSV line of results
+ * Parameters: result
+ * Returns: N/A
+ */
+void print_result(struct result *result)
+{
+        double pixels = (double) result->width * result->height;
+
+        printf("%s,%u,%u,%.6f,%.6f,%llu,%.4f,%.6f,%.4f,%u\n", result->path,
+               result->width, result->height, result->encodeSeconds,
+               result->decodeSeconds,
+               (unsigned long long) result->compressedBytes,
+               8.0 * result->compressedBytes / pixels,
+               Imagediff_rmse(&result->diff, IMAGEDIFF_ALL),
+               Imagediff_psnr(&result->diff, IMAGEDIFF_ALL, 255),
+               Imagediff_max_error(&result->diff, IMAGEDIFF_ALL));
+}
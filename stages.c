@@ -0,0 +1,40 @@
+/*
+ *     stages.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the stage markers whose
+ *      declarations are included in stages.h.
+ *     
+ */ 
+
+#include <stddef.h>
+#include "stages.h"
+
+static Stages_hook *current_hook = NULL;
+static void *current_cl = NULL;
+
+/* Stages_set_hook
+ * Purpose: installs the function called by every later Stages_mark, or
+ *              removes it
+ * Parameters: hook (NULL for none), closure passed to it
+ * Returns: N/A
+ */
+void Stages_set_hook(Stages_hook *hook, void *cl)
+{
+        current_hook = hook;
+        current_cl = cl;
+}
+
+/* Stages_mark
+ * Purpose: marks the end of a pipeline stage, calling the hook if there is
+ *              one
+ * Parameters: name of the stage that just finished
+ * Returns: N/A
+ */
+void Stages_mark(const char *stage)
+{
+        if (current_hook != NULL) {
+                current_hook(stage, current_cl);
+        }
+}
@@ -0,0 +1,23 @@
+/*
+ *     stages.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the stage markers. The staged 
+ *      compressor and decompressor call Stages_mark at the end of every
+ *      step with the step's name; a tool that wants to time or measure the
+ *      steps installs a hook to be called from there. With no hook 
+ *      installed a mark is a single test.
+ *     
+ */ 
+
+#ifndef STAGES_H
+#define STAGES_H
+
+/* called at the end of the named stage */
+typedef void Stages_hook(const char *stage, void *cl);
+
+void Stages_set_hook(Stages_hook *hook, void *cl);
+void Stages_mark(const char *stage);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ *     stats.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the job statistics whose
+ *      declarations are included in stats.h. Tools that load several
+ *      files at once count from several threads, so the counters are
+ *      bumped with relaxed atomic adds. Wall time is CLOCK_MONOTONIC and
+ *      CPU time is CLOCK_PROCESS_CPUTIME_ID, which adds up every thread of
+ *      the band-parallel stages. Memory is the peak held through mem.h
+ *      during each stage (see memtrack.h).
+ *
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "assert.h"
+#include "stages.h"
+#include "stats.h"
+#include "memtrack.h"
+#include "timing.h"
+
+#define MAX_STAGES 32
+
+/* counters and clocks at one point of the job */
+struct snapshot {
+        double wall;
+        double cpu;
+        uint64_t bytesRead;
+        uint64_t bytesWritten;
+        uint64_t blocks;
+};
+
+/* one finished stage: its name, what it used (end minus start) and the
+ * most memory it held at once
+ */
+struct stage {
+        const char *name;
+        struct snapshot used;
+        uint64_t peakBytes;
+};
+
+static struct snapshot counters = { 0, 0, 0, 0, 0 };
+static struct snapshot start;
+static struct snapshot last;
+static struct stage stages[MAX_STAGES];
+static int num_stages = 0;
+
+static void record_stage(const char *stage, void *cl);
+static struct snapshot take_snapshot(void);
+static struct snapshot difference(struct snapshot end, struct snapshot begin);
+static void print_text(FILE *output, const char *name, struct snapshot used,
+                       uint64_t peakBytes);
+static void print_json(FILE *output, const char *name, struct snapshot used,
+                       uint64_t peakBytes);
+
+/* Stats_start
+ * Purpose: starts recording: from now on every stage marker records a stage
+ * Parameters: N/A
+ * Returns: N/A
+ */
+void Stats_start(void)
+{
+        num_stages = 0;
+        start = take_snapshot();
+        last = start;
+        Memtrack_start_stage();
+        Stages_set_hook(record_stage, NULL);
+}
+
+/* Stats_count_read
+ * Purpose: counts bytes read from an input file (or mapped from it)
+ * Parameters: number of bytes
+ * Returns: N/A
+ */
+void Stats_count_read(uint64_t bytes)
+{
+        __atomic_fetch_add(&counters.bytesRead, bytes, __ATOMIC_RELAXED);
+}
+
+/* Stats_count_written
+ * Purpose: counts bytes written to an output file
+ * Parameters: number of bytes
+ * Returns: N/A
+ */
+void Stats_count_written(uint64_t bytes)
+{
+        __atomic_fetch_add(&counters.bytesWritten, bytes, __ATOMIC_RELAXED);
+}
+
+/* Stats_count_blocks
+ * Purpose: counts 2x2 blocks compressed or decompressed
+ * Parameters: number of blocks
+ * Returns: N/A
+ */
+void Stats_count_blocks(uint64_t blocks)
+{
+        __atomic_fetch_add(&counters.blocks, blocks, __ATOMIC_RELAXED);
+}
+
+/* Stats_report
+ * Purpose: prints every stage recorded since Stats_start, then the totals
+ *              of the whole job, as a table or as one JSON object
+ * Parameters: file to print to (normally stderr), whether to print JSON
+ * Returns: N/A
+ */
+void Stats_report(FILE *output, bool json)
+{
+        assert(output != NULL);
+        struct snapshot total = difference(take_snapshot(), start);
+
+        if (json) {
+                fprintf(output, "{\"stages\": [");
+                for (int i = 0; i < num_stages; i++) {
+                        fprintf(output, "%s\n  ", (i == 0) ? "" : ",");
+                        print_json(output, stages[i].name, stages[i].used,
+                                   stages[i].peakBytes);
+                }
+                fprintf(output, "],\n \"total\": ");
+                print_json(output, "total", total, Memtrack_peak());
+                fprintf(output, ",\n \"live_bytes\": %llu}\n",
+                        (unsigned long long) Memtrack_live());
+        } else {
+                fprintf(output, "%-22s %10s %10s %14s %14s %12s %14s\n",
+                        "stage", "wall (s)", "cpu (s)", "bytes read",
+                        "bytes written", "blocks", "peak bytes");
+                for (int i = 0; i < num_stages; i++) {
+                        print_text(output, stages[i].name, stages[i].used,
+                                   stages[i].peakBytes);
+                }
+                print_text(output, "total", total, Memtrack_peak());
+                fprintf(output, "%-22s %81llu\n", "live at end",
+                        (unsigned long long) Memtrack_live());
+        }
+}
+
+/* record_stage
+ * Purpose: stage hook: records what was used since the previous mark
+ * Parameters: name of the stage that just finished, unused closure
+ * Returns: N/A
+ */
+static void record_stage(const char *stage, void *cl)
+{
+        (void) cl;
+        struct snapshot now = take_snapshot();
+
+        if (num_stages < MAX_STAGES) {
+                stages[num_stages].name = stage;
+                stages[num_stages].used = difference(now, last);
+                stages[num_stages].peakBytes = Memtrack_stage_peak();
+                num_stages++;
+        }
+        last = now;
+        Memtrack_start_stage();
+}
+
+/* take_snapshot
+ * Purpose: reads the clocks and the counters
+ * Parameters: N/A
+ * Returns: the snapshot
+ */
+static struct snapshot take_snapshot(void)
+{
+        struct snapshot now;
+        now.bytesRead = __atomic_load_n(&counters.bytesRead, __ATOMIC_RELAXED);
+        now.bytesWritten = __atomic_load_n(&counters.bytesWritten,
+                                           __ATOMIC_RELAXED);
+        now.blocks = __atomic_load_n(&counters.blocks, __ATOMIC_RELAXED);
+        now.wall = Timing_seconds(CLOCK_MONOTONIC);
+        now.cpu = Timing_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+        return now;
+}
+
+/* difference
+ * Purpose: computes what was used between two snapshots
+ * Parameters: later and earlier snapshot
+ * Returns: later minus earlier, field by field
+ */
+static struct snapshot difference(struct snapshot end, struct snapshot begin)
+{
+        struct snapshot used;
+        used.wall = end.wall - begin.wall;
+        used.cpu = end.cpu - begin.cpu;
+        used.bytesRead = end.bytesRead - begin.bytesRead;
+        used.bytesWritten = end.bytesWritten - begin.bytesWritten;
+        used.blocks = end.blocks - begin.blocks;
+
+        return used;
+}
+
+/* print_text
+ * Purpose: prints one row of the table
+ * Parameters: file to print to, stage name, what the stage used, its peak
+ *              memory
+ * Returns: N/A
+ */
+static void print_text(FILE *output, const char *name, struct snapshot used,
+                       uint64_t peakBytes)
+{
+        fprintf(output, "%-22s %10.6f %10.6f %14llu %14llu %12llu %14llu\n",
+                name, used.wall, used.cpu,
+                (unsigned long long) used.bytesRead,
+                (unsigned long long) used.bytesWritten,
+                (unsigned long long) used.blocks,
+                (unsigned long long) peakBytes);
+}
+
+/* print_json
+ * Purpose: prints one stage as a JSON object
+ * Parameters: file to print to, stage name, what the stage used, its peak
+ *              memory
+ * Returns: N/A
+ */
+static void print_json(FILE *output, const char *name, struct snapshot used,
+                       uint64_t peakBytes)
+{
+        fprintf(output, "{\"stage\": \"%s\", \"wall_seconds\": %.6f, "
+                "\"cpu_seconds\": %.6f, \"bytes_read\": %llu, "
+                "\"bytes_written\": %llu, \"blocks\": %llu, "
+                "\"peak_bytes\": %llu}", name, used.wall, used.cpu,
+                (unsigned long long) used.bytesRead,
+                (unsigned long long) used.bytesWritten,
+                (unsigned long long) used.blocks,
+                (unsigned long long) peakBytes);
+}
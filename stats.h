@@ -0,0 +1,29 @@
+/*
+ *     stats.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the interface of the job statistics printed by
+ *      40image --stats. The I/O functions count the bytes they read and
+ *      write and the drivers count the blocks they code; once Stats_start
+ *      has been called, every stage marker (see stages.h) records the wall
+ *      time, CPU time, bytes and blocks of the stage that just finished.
+ *      Counting is a single add, and with statistics off a stage marker is
+ *      a single test, so the counters stay in production builds.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+void Stats_start(void);
+void Stats_count_read(uint64_t bytes);
+void Stats_count_written(uint64_t bytes);
+void Stats_count_blocks(uint64_t blocks);
+void Stats_report(FILE *output, bool json);
+
+#endif
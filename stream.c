@@ -0,0 +1,143 @@
+/*
+ *     stream.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the implementation of the streaming compressor
+ *      and decompressor whose declarations are included in compression.h.
+ *      Instead of loading the whole image, the compressor reads two raw
+ *      rows of pixels at a time (see rawppm.h), and writes each row of 
+ *      codewords as soon as it is ready. The decompressor reads one
+ *      row of codewords at a time and writes the matching two rows of the
+ *      PPM. Either way memory use only depends on the image width.
+ *     
+ */ 
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "pnm.h"
+#include "assert.h"
+#include "compression.h"
+#include "mem.h"
+#include "rawppm.h"
+#include "stages.h"
+#include "stats.h"
+
+static void put_codeword_row(unsigned char *bytes, int width, 
+                             FILE *output);
+static void get_codeword_row(unsigned char *bytes, int width, FILE *input);
+
+/* compress40_stream
+ * Purpose: streaming version of compress40: reads a PPM two rows at a time
+ *              and writes the compressed image to standard output one row
+ *              of codewords at a time. The output is identical to 
+ *              compress40's.
+ * Parameters: file to read the PPM from
+ * Returns: N/A
+ */
+void compress40_stream(FILE *input)
+{
+        /* streaming needs a raw PPM, there is no netpbm fallback here */
+        struct Rawppm header;
+        bool raw = Rawppm_read_header(&input, &header);
+        assert(raw);
+
+        /* if width or height is not even, cut it down, then count blocks */
+        int width = makeEven((int) header.width) / 2;
+        int height = makeEven((int) header.height) / 2;
+
+        /* the only buffers: two raw pixel rows, one codeword row */
+        unsigned char *top = ALLOC(header.rowBytes + 1);
+        unsigned char *bottom = ALLOC(header.rowBytes + 1);
+        unsigned char *bytes = ALLOC((long) width * 4 + 1);
+
+        int headerBytes = printf("COMP40 Compressed image format 2\n%u %u\n", 
+                            width, height);
+        assert(headerBytes > 0);
+        Stats_count_written(headerBytes);
+
+        for (int row = 0; row < height; row++) {
+                Rawppm_read_row(input, &header, top);
+                Rawppm_read_row(input, &header, bottom);
+
+                compress_raw_rows(top, bottom, width, 
+                                  (int) header.bytesPerSample,
+                                  (int) header.denominator, bytes);
+                put_codeword_row(bytes, width, stdout);
+        }
+        Stats_count_blocks((uint64_t) width * height);
+        Stages_mark("stream_compress");
+
+        FREE(top);
+        FREE(bottom);
+        FREE(bytes);
+}
+
+/* decompress40_stream
+ * Purpose: streaming version of decompress40: reads one row of codewords at
+ *              a time and writes the matching two rows of the PPM to 
+ *              standard output right away. The output is identical to 
+ *              decompress40's.
+ * Parameters: file to read the compressed image from
+ * Returns: N/A
+ */
+void decompress40_stream(FILE *input)
+{
+        unsigned height, width;
+
+        /* read in header, see read_compressed */
+        read_compressed_header(input, &width, &height);
+        check_compressed_size(input, width, height);
+
+        unsigned pixelWidth = width * 2;
+        size_t rowBytes = (size_t) pixelWidth * 3;
+
+        /* the only buffers: one codeword row, two raw pixel rows */
+        unsigned char *bytes = ALLOC((long) width * 4 + 1);
+        unsigned char *rows = ALLOC(rowBytes * 2 + 1);
+
+        Rawppm_write_header(stdout, pixelWidth, height * 2);
+
+        for (unsigned row = 0; row < height; row++) {
+                get_codeword_row(bytes, (int) width, input);
+
+                decompress_raw_row(bytes, (int) width, rows, rows + rowBytes);
+                Rawppm_write_rows(stdout, rows, pixelWidth, 2);
+        }
+        Stats_count_blocks((uint64_t) width * height);
+        Stages_mark("stream_decompress");
+
+        FREE(bytes);
+        FREE(rows);
+}
+
+/* put_codeword_row
+ * Purpose: writes one row of codewords, already packed as big endian 
+ *              bytes, with a single fwrite
+ * Parameters: row of 4 * width bytes, number of codewords, file to write to
+ * Returns: N/A
+ */
+static void put_codeword_row(unsigned char *bytes, int width, FILE *output)
+{
+        size_t written = fwrite(bytes, 4, width, output);
+        assert(written == (size_t) width);
+        Stats_count_written(4 * written);
+}
+
+/* get_codeword_row
+ * Purpose: reads one row of big endian codewords with a single fread; they
+ *              are unpacked straight from the bytes
+ * Parameters: destination of 4 * width bytes, number of codewords, file to
+ *              read from
+ * Returns: N/A
+ * Raises: Compressed_Truncated if the file ends first
+ */
+static void get_codeword_row(unsigned char *bytes, int width, FILE *input)
+{
+        size_t read = fread(bytes, 4, width, input);
+        if (read != (size_t) width) {
+                RAISE(Compressed_Truncated);
+        }
+        Stats_count_read(4 * read);
+}
@@ -0,0 +1,32 @@
+/*
+ *     timing.h
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains the clock reading shared by the benchmarks, the
+ *      round trip evaluator and the job statistics, as a static inline
+ *      function so that tools which link none of the codec can use it.
+ *      Wall times are read from CLOCK_MONOTONIC; the statistics also read
+ *      CLOCK_PROCESS_CPUTIME_ID for CPU time.
+ *
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+/* Timing_seconds
+ * Purpose: reads a clock
+ * Parameters: clock to read
+ * Returns: its time in seconds
+ */
+static inline double Timing_seconds(clockid_t clock)
+{
+        struct timespec now;
+        clock_gettime(clock, &now);
+
+        return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+#endif
@@ -3,8 +3,8 @@
  *  By Gillian Feder (gfeder01) and Max Shellist (mshell01), October 2022
  *  locality
  *
- *  Implementation of a blocked UArray2. Individual blocks are represented 
- *  as UArrays.
+ *  Implementation of a blocked UArray2. Every block lives in one 
+ *  contiguous, cache line aligned buffer, in block major order.
  *      
  */
 
@@ -14,10 +14,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <uarray.h>
-#include <uarray2.h>
+#include <stdint.h>
 #include <uarray2b.h>
-#include "pnm.h"
+
+/* alignment in bytes of the cell buffer */
+#define CACHE_LINE 64
 
 struct UArray2b_T {
         int width;
@@ -25,18 +26,42 @@ struct UArray2b_T {
         int size;
         int blocksize;
 
-        UArray2_T blocks;
+        /* blocks in each row and each column of blocks */
+        int blocksWide;
+        int blocksHigh;
+
+        /* log2(blocksize) and blocksize - 1 if blocksize is a power of 
+         * two, otherwise shift is -1 and at() divides
+         */
+        int shift;
+        int mask;
+
+        /* every block in row major order, each block holding its 
+         * blocksize * blocksize cells in row major order
+         */
+        long blockBytes;
+        char *cells;
+        void *storage;
 };
 
 #define T UArray2b_T
 
-/* Initialize a new blocked 2D array. Initialize each block as a UArray.
-*/
+typedef void applyfun(int col, int row, T array2b, void *elem, void *cl);
+
+static inline void map_full_block(T array2b, char *block, int left, int top,
+                                  applyfun apply, void *cl);
+static void map_partial_block(T array2b, char *block, int left, int top,
+                              int rows, int cols, applyfun apply, void *cl);
+
+/* Initialize a new blocked 2D array, backed by one zeroed, cache line
+ * aligned buffer holding all of its blocks back to back.
+ */
 extern T UArray2b_new (int width, int height, int size, int blocksize) 
 {
         T arr2b;
         NEW(arr2b);
         assert(arr2b != NULL && blocksize >= 1); 
+        assert(width >= 0 && height >= 0 && size > 0);
 
         arr2b->width     = width; 
         arr2b->height    = height;
@@ -47,24 +72,31 @@ extern T UArray2b_new (int width, int height, int size, int blocksize)
         if (size > 64000) {
                 arr2b->blocksize = 1;
         }
+        blocksize = arr2b->blocksize;
 
-        /* initialize blocks array */  
-        arr2b->blocks = UArray2_new((int)ceil((double)width  / blocksize), 
-                                    (int)ceil((double)height / blocksize), 
-                                    sizeof(UArray_T));
-        
-        /* set each block to a UArray */
-        for (int col = 0; col < UArray2_width(arr2b->blocks); col++) {
-                for (int row = 0; row < UArray2_height(arr2b->blocks); row++) {
-
-                        UArray_T block = UArray_new(arr2b->blocksize * 
-                                        arr2b->blocksize, size);
-                        assert(block != NULL);
-
-                        *(UArray_T *)UArray2_at(arr2b->blocks, col, row) = 
-                                                                        block;
+        arr2b->blocksWide = (width + blocksize - 1) / blocksize;
+        arr2b->blocksHigh = (height + blocksize - 1) / blocksize;
+
+        arr2b->shift = -1;
+        arr2b->mask = blocksize - 1;
+        if ((blocksize & (blocksize - 1)) == 0) {
+                arr2b->shift = 0;
+                while ((1 << arr2b->shift) < blocksize) {
+                        arr2b->shift++;
                 }
         }
+
+        /* one allocation for every cell, padded to align the first one */
+        arr2b->blockBytes = (long) blocksize * blocksize * size;
+        long bytes = arr2b->blockBytes * arr2b->blocksWide * 
+                                         arr2b->blocksHigh;
+        arr2b->storage = CALLOC(1, bytes + CACHE_LINE);
+        assert(arr2b->storage != NULL);
+
+        uintptr_t start = (uintptr_t) arr2b->storage;
+        arr2b->cells = (char *) arr2b->storage + 
+                       ((CACHE_LINE - start % CACHE_LINE) % CACHE_LINE);
+
         return arr2b;
 }
 
@@ -74,29 +106,21 @@ extern T UArray2b_new (int width, int height, int size, int blocksize)
  */
 extern T UArray2b_new_64K_block(int width, int height, int size) 
 {
-        return UArray2b_new (width,  height,  size, (int)floor(sqrt(65536.0/
-                                                                    size))); 
-
+        int blocksize = (int) floor(sqrt(65536.0 / size));
+        if (blocksize < 1) {
+                blocksize = 1;
+        }
+        return UArray2b_new(width, height, size, blocksize); 
 }
 
-/* Frees all internal structures an the entire UArray2b, by looping through
- * its blocks, freeing them, freeing the entire array, and the struct itself.
+/* Frees the cell buffer and the struct itself.
  */
 extern void UArray2b_free (T *array2b) 
 {
-        assert(*array2b != NULL);
-        for (int row = 0; row < UArray2_height((*array2b)->blocks); row++) {
-                for (int col = 0; col < UArray2_width((*array2b)->blocks); 
-                                                                col++) {
-                        UArray_T *block = UArray2_at(((*array2b)->blocks), col, 
-                                                                        row);
-                        UArray_free(block);
-                }
-        }
-        UArray2_free(&((*array2b)->blocks));
+        assert(array2b != NULL && *array2b != NULL);
+        FREE((*array2b)->storage);
         FREE(*array2b);
 }
-
 /* Return the width of the Uarray2b
  */
 extern int UArray2b_width (T array2b) 
@@ -130,31 +154,44 @@ extern int UArray2b_blocksize(T array2b)
 }
 
 
-/* Returns a pointer to the cell in the given column and row by first
- * retreiving the block and then calculating the correct index within
- * that block.
+/* Returns a pointer to the cell in the given column and row: the offset
+ * of its block in the buffer plus its index within that block, using 
+ * shifts and masks when the blocksize is a power of two.
  */
 extern void *UArray2b_at(T array2b, int column, int row) 
 {
-        assert(column < array2b->width && row < array2b->height);
         assert(array2b != NULL);
+        assert(column >= 0 && column < array2b->width && 
+               row >= 0 && row < array2b->height);
+
+        int blockCol, blockRow, index;
+        if (array2b->shift >= 0) {
+                int shift = array2b->shift;
+                int mask = array2b->mask;
 
-        /* get correct block */
-        UArray_T *block = UArray2_at(array2b->blocks, 
-                                    column / array2b->blocksize, 
-                                    row / array2b->blocksize);
+                blockCol = column >> shift;
+                blockRow = row >> shift;
+                index = ((row & mask) << shift) | (column & mask);
+        } else {
+                int blocksize = array2b->blocksize;
 
-        /* calculate correct index */
-        int index = array2b->blocksize * (row % array2b->blocksize) + 
-                                         (column % array2b->blocksize);
+                blockCol = column / blocksize;
+                blockRow = row / blocksize;
+                index = blocksize * (row - blockRow * blocksize) + 
+                                    (column - blockCol * blocksize);
+        }
 
-        return UArray_at(*block, index);
+        long block = (long) blockRow * array2b->blocksWide + blockCol;
+        return array2b->cells + block * array2b->blockBytes + 
+                                (long) index * array2b->size;
 } 
 
 /* Block major mapping function, traverses through the blocks in row major
  * order, and in each block, traverses through cells also in row major
- * order. Takes in the array to be traversed, the apply function, and
- * the closure pointer. 
+ * order, skipping the cells of edge blocks that lie outside the array. 
+ * Takes in the array to be traversed, the apply function, and the closure
+ * pointer. Full blocks take a loop with no bounds checks; only the right 
+ * column and bottom row of partial blocks are clipped.
  */
 extern void UArray2b_map(T array2b,
 void apply(int col, int row, T array2b,
@@ -163,53 +200,82 @@ void *cl)
 {
         assert(array2b != NULL);
 
-        /* iterate through our 2d array of blocks */
-        for (int i = 0; i < UArray2_height(array2b->blocks); i++) {
-                for (int j = 0; j < UArray2_width(array2b->blocks); j++) {
-
-                        /* get the current block */
-                        UArray_T *block = UArray2_at(array2b->blocks, j, i);
-
-                        /* iterate through the current block */
-                        for (int k = 0; k < UArray_length(*block); k++) {
-                                
-                                /* check if we are in a non-full block in the
-                                 * right column, and if current cell is valid
-                                 */
-                                if ((j == UArray2_width(array2b->blocks) - 1) &&
-                                    (array2b->width % array2b->blocksize != 0) 
-                                    && (k % array2b->blocksize >= 
-                                        array2b->width % array2b->blocksize)) {
-                                        /* if not valid, do not apply */
-                                        continue;
-                                }
-                                /* check if we are in a non-full block in the
-                                 * bottom row, and if the current cell is valid
-                                 */
-                                else if (i == UArray2_height(array2b->blocks) 
-                                                        - 1 && (array2b->height 
-                                        % array2b->blocksize != 0) && 
-                                        k == array2b->blocksize *  
-                                        (array2b->height % array2b->blocksize)){
-                                        /* if not valid, we know we are done
-                                         * with the current block
-                                         */
-                                        break;
-                                } 
-                                else {
-                                        /* get the cell coordinates from the
-                                         * block coordinates and position within
-                                         * the block 
-                                         */
-                                        int col = array2b->blocksize * j + k % 
-                                                        array2b->blocksize;
-                                        int row = array2b->blocksize * i + k / 
-                                                        array2b->blocksize;
-
-                                        apply(col, row, array2b, 
-                                                UArray_at(*block, k), cl);
-                                }
-                        }
+        int blocksize = array2b->blocksize;
+        int fullWide = array2b->width / blocksize;
+        int fullHigh = array2b->height / blocksize;
+        int edgeCols = array2b->width - fullWide * blocksize;
+        int edgeRows = array2b->height - fullHigh * blocksize;
+        char *block = array2b->cells;
+
+        for (int i = 0; i < fullHigh; i++) {
+                int top = i * blocksize;
+
+                for (int j = 0; j < fullWide; j++) {
+                        map_full_block(array2b, block, j * blocksize, top, 
+                                       apply, cl);
+                        block += array2b->blockBytes;
+                }
+                if (edgeCols > 0) {
+                        map_partial_block(array2b, block, fullWide * 
+                                          blocksize, top, blocksize, 
+                                          edgeCols, apply, cl);
+                        block += array2b->blockBytes;
+                }
+        }
+
+        /* bottom row of blocks, all of them cut short */
+        if (edgeRows > 0) {
+                int top = fullHigh * blocksize;
+
+                for (int j = 0; j < array2b->blocksWide; j++) {
+                        int cols = (j < fullWide) ? blocksize : edgeCols;
+                        map_partial_block(array2b, block, j * blocksize, top,
+                                          edgeRows, cols, apply, cl);
+                        block += array2b->blockBytes;
                 }
-        } 
-}
\ No newline at end of file
+        }
+}
+
+/* Applies the map function to every cell of a full block, whose top left
+ * cell is at (left, top). Blocks of 2x2, the compressor's, are unrolled.
+ */
+static inline void map_full_block(T array2b, char *block, int left, int top,
+                                  applyfun apply, void *cl)
+{
+        int blocksize = array2b->blocksize;
+        int size = array2b->size;
+
+        if (blocksize == 2) {
+                apply(left, top, array2b, block, cl);
+                apply(left + 1, top, array2b, block + size, cl);
+                apply(left, top + 1, array2b, block + 2 * size, cl);
+                apply(left + 1, top + 1, array2b, block + 3 * size, cl);
+                return;
+        }
+
+        char *cell = block;
+        for (int row = top; row < top + blocksize; row++) {
+                for (int col = left; col < left + blocksize; col++) {
+                        apply(col, row, array2b, cell, cl);
+                        cell += size;
+                }
+        }
+}
+
+/* Applies the map function to the first rows and columns of an edge block,
+ * the only cells of it that are part of the array.
+ */
+static void map_partial_block(T array2b, char *block, int left, int top,
+                              int rows, int cols, applyfun apply, void *cl)
+{
+        int size = array2b->size;
+        long rowBytes = (long) array2b->blocksize * size;
+
+        for (int r = 0; r < rows; r++) {
+                char *cell = block + r * rowBytes;
+                for (int c = 0; c < cols; c++) {
+                        apply(left + c, top + r, array2b, cell, cl);
+                        cell += size;
+                }
+        }
+}
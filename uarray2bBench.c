@@ -0,0 +1,279 @@
+/*
+ *     uarray2bBench.c
+ *     By Gillian Feder (gfeder01) and Adam Bernstein (aberns07), October 2022
+ *     Arith
+ *
+ *     This file contains a microbenchmark for UArray2b. It fills an array
+ *      of ints of the given size, then times a row major sweep of at()
+ *      calls and a block major UArray2b_map over it, for the contiguous
+ *      UArray2b and for the earlier layout (kept below as Legacy_*) that
+ *      stored every block as its own UArray in a UArray2 of handles and
+ *      divided by the blocksize on every access. Each is run with a power
+ *      of two blocksize (2, as in the compressor, and 16), a blocksize that
+ *      is not a power of two (3), and the 64KB blocksize. Results are CSV
+ *      on standard output; the checksums must match between layouts.
+ *
+ *     Usage: uarray2b_bench [width height [repetitions]]
+ *            (default 2048 by 2048)
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+#include <mem.h>
+#include <uarray.h>
+#include <uarray2.h>
+#include <uarray2b.h>
+#include "timing.h"
+
+/* the block layout UArray2b had before it used one contiguous buffer */
+typedef struct Legacy_T {
+        int width;
+        int height;
+        int size;
+        int blocksize;
+
+        UArray2_T blocks;
+} *Legacy_T;
+
+Legacy_T Legacy_new(int width, int height, int size, int blocksize);
+void Legacy_free(Legacy_T *array2b);
+void *Legacy_at(Legacy_T array2b, int column, int row);
+void Legacy_map(Legacy_T array2b, void apply(int col, int row,
+                Legacy_T array2b, void *elem, void *cl), void *cl);
+
+void sum_cell(int col, int row, UArray2b_T array2b, void *elem, void *cl);
+void sum_legacy_cell(int col, int row, Legacy_T array2b, void *elem,
+                     void *cl);
+void bench_blocksize(int width, int height, int blocksize, int reps);
+void print_result(const char *layout, int blocksize, const char *operation,
+                  double seconds, double cells, uint64_t checksum);
+
+int main(int argc, char *argv[])
+{
+        if (argc != 1 && argc != 3 && argc != 4) {
+                fprintf(stderr, "Usage: %s [width height [repetitions]]\n",
+                                                                argv[0]);
+                exit(EXIT_FAILURE);
+        }
+        int width = (argc >= 3) ? atoi(argv[1]) : 2048;
+        int height = (argc >= 3) ? atoi(argv[2]) : 2048;
+        int reps = (argc == 4) ? atoi(argv[3]) : 3;
+        assert(width > 0 && height > 0 && reps >= 1);
+
+        printf("layout,blocksize,operation,seconds,million_cells_per_second,"
+               "checksum\n");
+        bench_blocksize(width, height, 2, reps);
+        bench_blocksize(width, height, 3, reps);
+        bench_blocksize(width, height, 16, reps);
+        bench_blocksize(width, height,
+                        (int) floor(sqrt(65536.0 / sizeof(int))), reps);
+
+        return EXIT_SUCCESS;
+}
+
+/* bench_blocksize
+ * Purpose: times at() and map over both layouts for one blocksize, each
+ *              the best of reps runs
+ * Parameters: width and height in cells, blocksize, repetitions
+ * Returns: N/A
+ */
+void bench_blocksize(int width, int height, int blocksize, int reps)
+{
+        UArray2b_T array = UArray2b_new(width, height, sizeof(int),
+                                        blocksize);
+        Legacy_T legacy = Legacy_new(width, height, sizeof(int), blocksize);
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        *(int *) UArray2b_at(array, col, row) = col ^ row;
+                        *(int *) Legacy_at(legacy, col, row) = col ^ row;
+                }
+        }
+
+        double cells = (double) width * height;
+        double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+        uint64_t sums[4] = { 0, 0, 0, 0 };
+
+        for (int r = 0; r < reps; r++) {
+                for (int test = 0; test < 4; test++) {
+                        uint64_t sum = 0;
+                        double start = Timing_seconds(CLOCK_MONOTONIC);
+                        if (test == 0 || test == 1) {
+                                for (int row = 0; row < height; row++) {
+                                        for (int col = 0; col < width;
+                                                                col++) {
+                                                sum += (test == 0) ?
+                                                *(int *) Legacy_at(legacy,
+                                                                col, row) :
+                                                *(int *) UArray2b_at(array,
+                                                                col, row);
+                                        }
+                                }
+                        } else if (test == 2) {
+                                Legacy_map(legacy, sum_legacy_cell, &sum);
+                        } else {
+                                UArray2b_map(array, sum_cell, &sum);
+                        }
+
+                        double seconds = Timing_seconds(CLOCK_MONOTONIC) -
+                                         start;
+                        if (seconds < best[test]) {
+                                best[test] = seconds;
+                        }
+                        sums[test] = sum;
+                }
+        }
+
+        print_result("legacy", blocksize, "at", best[0], cells, sums[0]);
+        print_result("contiguous", blocksize, "at", best[1], cells, sums[1]);
+        print_result("legacy", blocksize, "map", best[2], cells, sums[2]);
+        print_result("contiguous", blocksize, "map", best[3], cells,
+                                                                sums[3]);
+
+        UArray2b_free(&array);
+        Legacy_free(&legacy);
+}
+
+/* print_result
+ * Purpose: prints one CSV line of results
+ * Parameters: layout, blocksize, operation, best time, number of cells
+ *              visited, checksum of the visited cells
+ * Returns: N/A
+ */
+void print_result(const char *layout, int blocksize, const char *operation,
+                  double seconds, double cells, uint64_t checksum)
+{
+        printf("%s,%d,%s,%.6f,%.1f,%llu\n", layout, blocksize, operation,
+               seconds, cells / seconds / 1e6, (unsigned long long) checksum);
+}
+
+/* sum_cell
+ * Purpose: map apply function adding every int cell to a total
+ * Parameters: column, row, array, cell, total (uint64_t)
+ * Returns: N/A
+ */
+void sum_cell(int col, int row, UArray2b_T array2b, void *elem, void *cl)
+{
+        (void) col;
+        (void) row;
+        (void) array2b;
+        *(uint64_t *) cl += *(int *) elem;
+}
+
+/* sum_legacy_cell
+ * Purpose: sum_cell for the legacy layout
+ * Parameters: column, row, array, cell, total (uint64_t)
+ * Returns: N/A
+ */
+void sum_legacy_cell(int col, int row, Legacy_T array2b, void *elem,
+                     void *cl)
+{
+        (void) col;
+        (void) row;
+        (void) array2b;
+        *(uint64_t *) cl += *(int *) elem;
+}
+
+/* ======================================================================
+                        LEGACY UARRAY2B LAYOUT
+   ====================================================================== */
+
+/* Legacy_new
+ * Purpose: allocates a separate UArray for every block, as UArray2b_new
+ *              used to
+ * Parameters: width, height, size of a cell, blocksize
+ * Returns: the new array
+ */
+Legacy_T Legacy_new(int width, int height, int size, int blocksize)
+{
+        Legacy_T arr2b;
+        NEW(arr2b);
+        assert(blocksize >= 1);
+
+        arr2b->width = width;
+        arr2b->height = height;
+        arr2b->size = size;
+        arr2b->blocksize = blocksize;
+        arr2b->blocks = UArray2_new((width + blocksize - 1) / blocksize,
+                                    (height + blocksize - 1) / blocksize,
+                                    sizeof(UArray_T));
+
+        for (int col = 0; col < UArray2_width(arr2b->blocks); col++) {
+                for (int row = 0; row < UArray2_height(arr2b->blocks); row++) {
+                        *(UArray_T *) UArray2_at(arr2b->blocks, col, row) =
+                                UArray_new(blocksize * blocksize, size);
+                }
+        }
+        return arr2b;
+}
+
+/* Legacy_free
+ * Purpose: frees every block, the array of blocks and the struct
+ * Parameters: pointer to the array
+ * Returns: N/A
+ */
+void Legacy_free(Legacy_T *array2b)
+{
+        for (int row = 0; row < UArray2_height((*array2b)->blocks); row++) {
+                for (int col = 0; col < UArray2_width((*array2b)->blocks);
+                                                                col++) {
+                        UArray_free(UArray2_at((*array2b)->blocks, col, row));
+                }
+        }
+        UArray2_free(&(*array2b)->blocks);
+        FREE(*array2b);
+}
+
+/* Legacy_at
+ * Purpose: finds a cell through the UArray2 of blocks and the block's
+ *              UArray, with a / and a % by the blocksize
+ * Parameters: array, column, row
+ * Returns: pointer to the cell
+ */
+void *Legacy_at(Legacy_T array2b, int column, int row)
+{
+        assert(array2b != NULL);
+        assert(column < array2b->width && row < array2b->height);
+
+        UArray_T *block = UArray2_at(array2b->blocks,
+                                     column / array2b->blocksize,
+                                     row / array2b->blocksize);
+        int index = array2b->blocksize * (row % array2b->blocksize) +
+                                         (column % array2b->blocksize);
+
+        return UArray_at(*block, index);
+}
+
+/* Legacy_map
+ * Purpose: block major map over the legacy layout, testing every cell of
+ *              an edge block against the array bounds
+ * Parameters: array, apply function, closure
+ * Returns: N/A
+ */
+void Legacy_map(Legacy_T array2b, void apply(int col, int row,
+                Legacy_T array2b, void *elem, void *cl), void *cl)
+{
+        int blocksize = array2b->blocksize;
+
+        for (int i = 0; i < UArray2_height(array2b->blocks); i++) {
+                for (int j = 0; j < UArray2_width(array2b->blocks); j++) {
+                        UArray_T *block = UArray2_at(array2b->blocks, j, i);
+
+                        for (int k = 0; k < UArray_length(*block); k++) {
+                                int col = blocksize * j + k % blocksize;
+                                int row = blocksize * i + k / blocksize;
+                                if (col >= array2b->width) {
+                                        continue;
+                                }
+                                if (row >= array2b->height) {
+                                        break;
+                                }
+                                apply(col, row, array2b,
+                                      UArray_at(*block, k), cl);
+                        }
+                }
+        }
+}